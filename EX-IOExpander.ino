@@ -32,14 +32,21 @@
 #include <Arduino.h>
 #include "globals.h"
 #include "version.h"
+#if !defined(DIRECT_I2C)
 #include <Wire.h>
+#endif
 #include "pin_io_functions.h"
 #include "display_functions.h"
+#include "protocol_functions.h"
 #include "i2c_functions.h"
+#include "spi_functions.h"
+#include "uart_functions.h"
 #include "serial_functions.h"
 #include "test_functions.h"
 #include "device_functions.h"
 #include "servo_functions.h"
+#include "command_functions.h"
+#include "log_functions.h"
 
 #ifdef CPU_TYPE_ERROR
 #error Unsupported microcontroller architecture detected, you need to use a supported microcontroller. Refer to the documentation.
@@ -64,6 +71,17 @@
 #include "arduino_bluepill_f103c8.h"
 #endif
 
+/*
+* Check the pin counts in defines.h match the pin map, as every buffer is sized from them
+*/
+constexpr uint8_t countPins(uint8_t capabilities, uint8_t pin = 0) {
+  return pin == TOTAL_PINS ? 0 : ((pinMap[pin].capability & capabilities) != 0) + countPins(capabilities, pin + 1);
+}
+static_assert(countPins(bit(DIGITAL_INPUT) | bit(DIGITAL_OUTPUT)) == TOTAL_DIGITAL_PINS, "TOTAL_DIGITAL_PINS doesn't match the pin map");
+static_assert(countPins(bit(ANALOGUE_INPUT)) == TOTAL_ANALOGUE_PINS, "TOTAL_ANALOGUE_PINS doesn't match the pin map");
+static_assert(countPins(bit(PWM_OUTPUT)) == TOTAL_PWM_PINS, "TOTAL_PWM_PINS doesn't match the pin map");
+static_assert((TOTAL_ANALOGUE_PINS + 3) / 4 * 5 <= ANALOGUE_PIN_BYTES, "ANALOGUE_PIN_BYTES too small for packed 10 bit");
+
 /*
 * Global variables here
 */
@@ -75,7 +93,7 @@
 #endif
 uint8_t i2cAddress = I2C_ADDRESS;   // Assign address to a variable for validation and serial input
 uint8_t numPins = TOTAL_PINS;
-uint8_t* analoguePinMap;  // Map which analogue pin's value is in which byte
+uint8_t analoguePinMap[TOTAL_ANALOGUE_PINS];  // Map which analogue pin's value is in which byte
 bool outputTestState = LOW;   // Flag to set outputs high or low for testing
 
 #ifdef DIAG
@@ -109,8 +127,15 @@ void setup() {
   USB_SERIAL.println(i2cAddress, HEX);
   setVersion();
   setupPinDetails();
-  servoDataArray = (ServoData**) calloc(numPins, sizeof(ServoData*));
+  setupCapabilities();
+#if !defined(SPI_TRANSPORT) && !defined(UART_TRANSPORT) && !defined(DIRECT_I2C)
+#if defined(ARDUINO_ARCH_STM32)
+  Wire.begin(i2cAddress, true);   // The STM32 core only enables general call when asked
+#else
   Wire.begin(i2cAddress);
+#endif
+  enableGeneralCall();
+#endif
 // If desired and pins defined, disable I2C pullups
 #if defined(DISABLE_I2C_PULLUPS) && defined(I2C_SDA) && defined(I2C_SCL)
   USB_SERIAL.print(F("Disabling I2C pullups on pins SDA|SCL: "));
@@ -124,8 +149,20 @@ void setup() {
 // Need to intialise every pin in INPUT mode (no pull ups) for safe start
   initialisePins();
   USB_SERIAL.println(F("Initialised all pins as input only"));
+  setupAttentionPin();
+#if defined(SPI_TRANSPORT)
+  setupSPI();
+  USB_SERIAL.println(F("Using the SPI transport, I2C is disabled"));
+#elif defined(UART_TRANSPORT)
+  setupUART();
+  USB_SERIAL.println(F("Using the UART transport, I2C is disabled"));
+#elif defined(DIRECT_I2C)
+  setupDirectI2C(i2cAddress);
+  USB_SERIAL.println(F("Using the direct I2C driver instead of Wire"));
+#else
   Wire.onReceive(receiveEvent);
   Wire.onRequest(requestEvent);
+#endif
 #if (TEST_MODE == ANALOGUE_TEST)
   testAnalogue(true);
 #elif (TEST_MODE == INPUT_TEST)
@@ -135,24 +172,21 @@ void setup() {
 #elif (TEST_MODE == PULLUP_TEST)
   testPullup(true);
 #endif
-  uint8_t analoguePin = 0;
-  for (uint8_t pin = 0; pin < numPins; pin++) {
-    if (bitRead(pinMap[pin].capability, ANALOGUE_INPUT)) {
-      exioPins[pin].analogueLSBByte = analoguePin * 2;
-      analoguePinMap[analoguePin] = pin;
-      analoguePin++;
-    }            
-  }
 }
 
 /*
 * Main loop here, just processes our inputs and updates the writeBuffer.
 */
 void loop() {
+#if defined(UART_TRANSPORT)
+  processUART();
+#endif
+  processCommands();
   if (setupComplete) {
     processInputs();
     outputTestState = processOutputTest(outputTestState);
     processServos();
+    publishInputs();
     SuperPin::loop();
   }
   if (diag) {
@@ -160,4 +194,5 @@ void loop() {
   }
   processSerialInput();
   processDisplayOutput();
+  processLogOutput();
 }
@@ -23,7 +23,7 @@
 #include <Arduino.h>
 #include "globals.h"
 
-pinDefinition pinMap[TOTAL_PINS] = {
+constexpr pinDefinition pinMap[TOTAL_PINS] = {
   {2,DIOP},{3,DIOP},{4,DIOP},{5,DIOP},{6,DIOP},{7,DIOP},{8,DIOP},{9,DIOP},{10,DIOP},{11,DIOP},
   {12,DIOP},{13,DIOP},{14,DIO},{15,DIO},{16,DIO},{17,DIO},{18,DIO},{19,DIO},{22,DIO},{23,DIO},
   {24,DIO},{25,DIO},{26,DIO},{27,DIO},{28,DIO},{29,DIO},{30,DIO},{31,DIO},{32,DIO},{33,DIO},
@@ -33,7 +33,7 @@ pinDefinition pinMap[TOTAL_PINS] = {
   {A12,AIDIO},{A13,AIDIO},{A14,AIDIO},{A15,AIDIO},
 };
 
-pinName pinNameMap[TOTAL_PINS] = {
+const pinName pinNameMap[TOTAL_PINS] PROGMEM = {
   {2,"D2"},{3,"D3"},{4,"D4"},{5,"D5"},{6,"D6"},{7,"D7"},{8,"D8"},{9,"D9"},{10,"D10"},{11,"D11"},
   {12,"D12"},{13,"D13"},{14,"D14"},{15,"D15"},{16,"D16"},{17,"D17"},{18,"D18"},{19,"D19"},{22,"D22"},{23,"D23"},
   {24,"D24"},{25,"D25"},{26,"D26"},{27,"D27"},{28,"D28"},{29,"D29"},{30,"D30"},{31,"D31"},{32,"D32"},{33,"D33"},
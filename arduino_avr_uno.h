@@ -23,7 +23,7 @@
 #include <Arduino.h>
 #include "globals.h"
 
-pinDefinition pinMap[TOTAL_PINS] = {
+constexpr pinDefinition pinMap[TOTAL_PINS] = {
   {2,DIO},{3,DIOP},{4,DIO},{5,DIOP},{6,DIOP},{7,DIO},
   {8,DIO},{9,DIOP},{10,DIOP},{11,DIOP},{12,DIO},{13,DIO},
   {A0,AIDIO},{A1,AIDIO},{A2,AIDIO},{A3,AIDIO},
@@ -31,7 +31,7 @@ pinDefinition pinMap[TOTAL_PINS] = {
 #define I2C_SDA A4
 #define I2C_SCL A5
 
-pinName pinNameMap[TOTAL_PINS] = {
+const pinName pinNameMap[TOTAL_PINS] PROGMEM = {
   {2,"D2"},{3,"D3"},{4,"D4"},{5,"D5"},{6,"D6"},{7,"D7"},
   {8,"D8"},{9,"D9"},{10,"D10"},{11,"D11"},{12,"D12"},{13,"D13"},
   {A0,"A0"},{A1,"A1"},{A2,"A2"},{A3,"A3"},
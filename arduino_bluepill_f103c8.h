@@ -23,7 +23,7 @@
 #include <Arduino.h>
 #include "globals.h"
 
-pinDefinition pinMap[TOTAL_PINS] = {
+constexpr pinDefinition pinMap[TOTAL_PINS] = {
   {PC13,DIO},{PC14,DIO},{PC15,DIO},{PA0,AIDIO},{PA1,AIDIOP},{PA2,AIDIOP},{PA3,AIDIOP},{PA4,AIDIO},
   {PA5,AIDIO},{PA6,AIDIOP},{PA7,AIDIOP},{PB0,AIDIOP},{PB1,AIDIOP},{PB10,DIOP},{PB11,DIOP},
   {PB9,DIO},{PB8,DIO},{PB5,DIOP},{PB4,DIOP},{PB3,DIOP},{PA15,DIOP},
@@ -32,7 +32,7 @@ pinDefinition pinMap[TOTAL_PINS] = {
 #define I2C_SDA PB7
 #define I2C_SCL PB6
 
-pinName pinNameMap[TOTAL_PINS] = {
+const pinName pinNameMap[TOTAL_PINS] PROGMEM = {
   {PC13,"PC13"},{PC14,"PC14"},{PC15,"PC15"},{PA0,"PA0"},{PA1,"PA1"},{PA2,"PA2"},{PA3,"PA3"},{PA4,"PA4"},
   {PA5,"PA5"},{PA6,"PA6"},{PA7,"PA7"},{PB0,"PB0"},{PB1,"PB1"},{PB10,"PB10"},{PB11,"PB11"},
   {PB9,"PB9"},{PB8,"PB8"},{PB5,"PB5"},{PB4,"PB4"},{PB3,"PB3"},{PA15,"PA15"},
@@ -23,7 +23,7 @@
 #include <Arduino.h>
 #include "globals.h"
 
-pinDefinition pinMap[TOTAL_PINS] = {
+constexpr pinDefinition pinMap[TOTAL_PINS] = {
   {PC10,DIO},{PC12,DIO},{PA15,DIOP},{PB7,DIOP},{PC15,DIO},{PC2,AIDIO},{PC3,AIDIO},                  // CN7 outer pins
   {PC11,DIO},{PD2,DIO}, {PA0,AIDIOP},{PA1,AIDIOP},{PA4,AIDIO},{PB0,AIDIOP},{PC1,AIDIO},{PC0,AIDIO}, // CN7 inner pins
   {PC9,DIOP},{PA5,AIDIOP},{PA6,AIDIOP},{PA7,DIOP},{PB6,DIOP},{PC7,DIOP},{PA9,DIOP},{PA8,DIOP},{PB10,DIOP},{PB4,DIOP},{PB5,DIOP},{PB3,DIOP},{PA10,DIOP}, // CN10 inner pins
@@ -33,7 +33,7 @@ pinDefinition pinMap[TOTAL_PINS] = {
 #define I2C_SDA PB9
 #define I2C_SCL PB8
 
-pinName pinNameMap[TOTAL_PINS] = {
+const pinName pinNameMap[TOTAL_PINS] PROGMEM = {
   {PC10,"PC10"},{PC12,"PC12"},{PA15,"PA15"},{PB7,"PB7"},{PC15,"PC15"},{PC2,"PC2"},{PC3,"PC3"},        // CN7 outer pins
   {PC11,"PC11"},{PD2,"PD2"},{PA0,"PA0"},{PA1,"PA1"},{PA4,"PA4"},{PB0,"PB0"},{PC1,"PC1"},{PC0,"PC0"},  // CN7 inner pins
   {PC9,"PC9"},{PA5,"PA5"},{PA6,"PA6"},{PA7,"PA7"},{PB6,"PB6"},{PC7,"PC7"},{PA9,"PA9"},{PA8,"PA8"},{PB10,"PB10"},{PB4,"PB4"},{PB5,"PB5"},{PB3,"PB3"},{PA10,"PA10"},  // CN10 inner pins
@@ -23,7 +23,7 @@
 #include <Arduino.h>
 #include "globals.h"
 
-pinDefinition pinMap[TOTAL_PINS] = {
+constexpr pinDefinition pinMap[TOTAL_PINS] = {
   {PC10,DIO},{PC12,DIO},{PF6,DIOP},{PF7,DIOP},{PA15,DIOP},{PB7,DIOP},{PC13,DIO},{PC2,AIDIO},{PC3,AIDIO},{PD4,DIO},{PD5,DIO},{PD6,DIO},{PD7,DIO},{PE3,DIO},
   {PF1,DIO},{PF0,DIO},{PD1,DIO},{PD0,DIO},{PG0,DIO},{PE1,DIO},{PG9,DIO},{PG12,DIO},                                 // CN11 outer pins
   {PC11,DIO},{PD2,DIO},{PA0,AIDIOP},{PA1,AIDIOP},{PA4,AIDIO},{PB0,AIDIOP},{PC1,AIDIO},{PC0,AIDIO},{PD3,DIO},{PG2,DIO},{PG3,DIO},{PE2,DIO},{PE4,DIO},
@@ -37,7 +37,7 @@ pinDefinition pinMap[TOTAL_PINS] = {
 #define I2C_SDA PB9
 #define I2C_SCL PB8
 
-pinName pinNameMap[TOTAL_PINS] = {
+const pinName pinNameMap[TOTAL_PINS] PROGMEM = {
   {PC10,"PC10"},{PC12,"PC12"},{PF6,"PF6"},{PF7,"PF7"},{PA15,"PA15"},{PB7,"PB7"},{PC13,"PC13"},{PC2,"PC2"},{PC3,"PC3"},{PD4,"PD4"},{PD5,"PD5"},{PD6,"PD6"},{PD7,"PD7"},{PE3,"PE3"},
   {PF1,"PF1"},{PF0,"PF0"},{PD1,"PD1"},{PD0,"PD0"},{PG0,"PG0"},{PE1,"PE1"},{PG9,"PG9"},{PG12,"PG12"},              // CN11 outer pins
   {PC11,"PC11"},{PD2,"PD2"},{PA0,"PA0"},{PA1,"PA1"},{PA4,"PA4"},{PB0,"PB0"},{PC1,"PC1"},{PC0,"PC0"},{PD3,"PD3"},{PG2,"PG2"},{PG3,"PG3"},{PE2,"PE2"},{PE4,"PE4"},
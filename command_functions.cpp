@@ -0,0 +1,310 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+* Commands that change pin configuration or outputs are validated and queued by receiveEvent(),
+* then executed from loop() so the I2C interrupt never calls pinMode(), attaches servos or
+* prints errors. receiveEvent() is the only producer and processCommands() the only consumer,
+* so the queue needs no locking.
+*/
+
+#include <Arduino.h>
+#include "globals.h"
+#include "command_functions.h"
+#include "pin_io_functions.h"
+#include "log_functions.h"
+
+volatile byte commandQueue[COMMAND_QUEUE_SIZE];   // Queued frames, each stored as length then frame bytes
+volatile uint8_t commandQueueHead = 0;  // Next free byte, only written by queueCommand()
+volatile uint8_t commandQueueTail = 0;  // Next frame to execute, only written by processCommands()
+bool outputLatch = false;   // Hold output writes until EXIOCOMMIT when true
+byte stagedOutputs[STAGED_OUTPUT_SIZE];   // Held EXIOWRAN frames, each stored as length then frame bytes
+uint8_t stagedOutputBytes = 0;
+
+/*
+* Function to check a frame is complete and the pins it uses are capable of what's asked
+* This only uses pinMap so it is safe to call from receiveEvent(), pins already in use for
+* something else are reported when the command is executed
+*/
+bool validateCommand(byte* frame, uint8_t frameBytes) {
+  switch(frame[0]) {
+    case EXIOINIT:
+      return frameBytes == 4;
+    case EXIODPUP:
+      return frameBytes == 3 && frame[1] < numPins && bitRead(pinMap[frame[1]].capability, DIGITAL_INPUT);
+    case EXIOWRD:
+      return frameBytes == 3 && frame[1] < numPins && bitRead(pinMap[frame[1]].capability, DIGITAL_OUTPUT);
+    case EXIOENAN:
+      return frameBytes == 2 && frame[1] < numPins && bitRead(pinMap[frame[1]].capability, ANALOGUE_INPUT);
+    case EXIOWRAN:
+      return frameBytes == 7 && frame[1] < numPins &&
+        (bitRead(pinMap[frame[1]].capability, DIGITAL_OUTPUT) || bitRead(pinMap[frame[1]].capability, PWM_OUTPUT));
+    case EXIOWRDM: {
+      if (frameBytes < 5 || frameBytes != 3 + frame[2] * 2) return false;
+      uint8_t maskBytes = frame[2];
+      for (uint8_t maskByte = 0; maskByte < maskBytes; maskByte++) {
+        byte changeBits = frame[3 + maskByte] | frame[3 + maskBytes + maskByte];
+        for (uint8_t maskBit = 0; changeBits != 0 && maskBit < 8; maskBit++) {
+          if (!bitRead(changeBits, maskBit)) continue;
+          uint16_t pin = frame[1] + maskByte * 8 + maskBit;
+          if (pin >= numPins || !bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) return false;
+        }
+      }
+      return true;
+    }
+    case EXIOCFG:
+      return frameBytes >= 4 && frameBytes == 3 + (frame[2] + 3) / 4 && frame[1] + frame[2] <= numPins;
+    case EXIOANENC:
+      return frameBytes == 2 && frame[1] <= ANALOGUE_PACKED10;
+    case EXIOLATCH:
+      return frameBytes == 2 && frame[1] <= 1;
+    case EXIOCOMMIT:
+      return frameBytes == 1;
+    default:
+      return false;
+  }
+}
+
+/*
+* Function to validate each sub-command in an EXIOBATCH frame and build the status bitmap
+* Bit n of status is set if sub-command n will not be executed. Valid sub-commands still run when
+* others fail validation, but an unparseable remainder fails them all. Returns the number to run.
+*/
+uint8_t validateBatch(byte* batch, uint8_t batchBytes, byte* status, uint8_t* numCommands) {
+  uint8_t offset = 0;
+  uint8_t numValid = 0;
+  *numCommands = 0;
+  for (uint8_t statusByte = 0; statusByte < MAX_BATCH_COMMANDS / 8; statusByte++) {
+    status[statusByte] = 0;
+  }
+  while (offset < batchBytes && *numCommands < MAX_BATCH_COMMANDS) {
+    uint8_t commandBytes = batchCommandLength(batch[offset]);
+    if (commandBytes == 0 || offset + commandBytes > batchBytes) break;
+    uint8_t command = *numCommands;
+    if (validateCommand(&batch[offset], commandBytes)) {
+      numValid++;
+    } else {
+      bitSet(status[command / 8], command % 8);
+    }
+    offset += commandBytes;
+    (*numCommands)++;
+  }
+  if (offset != batchBytes) {
+    failBatch(status, *numCommands);
+    return 0;
+  }
+  return numValid;
+}
+
+/*
+* Function to mark every sub-command of a batch as not executed
+*/
+void failBatch(byte* status, uint8_t numCommands) {
+  for (uint8_t command = 0; command < numCommands; command++) {
+    bitSet(status[command / 8], command % 8);
+  }
+}
+
+/*
+* Function to return the frame length of a sub-command allowed in EXIOBATCH, 0 if not allowed
+*/
+uint8_t batchCommandLength(uint8_t command) {
+  switch(command) {
+    case EXIOENAN:
+      return 2;
+    case EXIODPUP:
+    case EXIOWRD:
+      return 3;
+    case EXIOWRAN:
+      return 7;
+    default:
+      return 0;
+  }
+}
+
+/*
+* Function to check every queued frame has been executed
+*/
+bool commandQueueEmpty() {
+  return commandQueueHead == commandQueueTail;
+}
+
+/*
+* Function to add a frame to the command queue, returns false if there is no room
+*/
+bool queueCommand(byte* frame, uint8_t frameBytes) {
+  uint8_t head = commandQueueHead;
+  uint8_t used = (head - commandQueueTail) & (COMMAND_QUEUE_SIZE - 1);
+  if (frameBytes + 1 > COMMAND_QUEUE_SIZE - 1 - used) return false;
+  commandQueue[head] = frameBytes;
+  for (uint8_t frameByte = 0; frameByte < frameBytes; frameByte++) {
+    head = (head + 1) & (COMMAND_QUEUE_SIZE - 1);
+    commandQueue[head] = frame[frameByte];
+  }
+  commandQueueHead = (head + 1) & (COMMAND_QUEUE_SIZE - 1);   // Publish the frame only once it's complete
+  return true;
+}
+
+/*
+* Function to check if a queued EXIOWRD or EXIOWRAN is superseded by a later write of the same
+* type to the same pin, so only the last one needs executing
+* Any other command in between stops the search so ordering with configuration is preserved
+*/
+bool isSuperseded(byte* frame, uint8_t next, uint8_t head) {
+  if (frame[0] != EXIOWRD && frame[0] != EXIOWRAN) return false;
+  while (next != head) {
+    uint8_t command = commandQueue[(next + 1) & (COMMAND_QUEUE_SIZE - 1)];
+    uint8_t pin = commandQueue[(next + 2) & (COMMAND_QUEUE_SIZE - 1)];
+    if (command != EXIOWRD && command != EXIOWRAN) return false;
+    if (pin == frame[1]) return command == frame[0];
+    next = (next + commandQueue[next] + 1) & (COMMAND_QUEUE_SIZE - 1);
+  }
+  return false;
+}
+
+/*
+* Function to execute all queued commands, called from loop()
+*/
+void processCommands() {
+  uint8_t head = commandQueueHead;
+  uint8_t tail = commandQueueTail;
+  while (tail != head) {
+    uint8_t frameBytes = commandQueue[tail];
+    byte frame[frameBytes];
+    for (uint8_t frameByte = 0; frameByte < frameBytes; frameByte++) {
+      frame[frameByte] = commandQueue[(tail + 1 + frameByte) & (COMMAND_QUEUE_SIZE - 1)];
+    }
+    tail = (tail + frameBytes + 1) & (COMMAND_QUEUE_SIZE - 1);
+    if (!isSuperseded(frame, tail, head)) {
+      executeCommand(frame, frameBytes);
+    }
+    commandQueueTail = tail;
+  }
+}
+
+/*
+* Function to write an EXIOWRD, EXIOWRAN or EXIOWRDM frame to the pins
+*/
+bool applyOutput(byte* frame) {
+  switch(frame[0]) {
+    case EXIOWRD:
+      return writeDigitalOutput(frame[1], frame[2]);
+    case EXIOWRAN: {
+      uint16_t value = (frame[3] << 8) + frame[2];
+      uint16_t duration = (frame[6] << 8) + frame[5];
+      return writeAnalogue(frame[1], value, frame[4], duration);
+    }
+    case EXIOWRDM: {
+      uint8_t maskBytes = frame[2];
+      return writeDigitalOutputs(frame[1], maskBytes, &frame[3], &frame[3 + maskBytes]);
+    }
+    default:
+      return false;
+  }
+}
+
+/*
+* Function to hold an output frame in latch mode until the next EXIOCOMMIT
+* Digital writes go into the staged output masks, EXIOWRAN frames are kept in order
+*/
+bool stageOutput(byte* frame, uint8_t frameBytes) {
+  if (frame[0] == EXIOWRD) {
+    byte setBits = frame[2] ? 1 : 0;
+    byte clearBits = frame[2] ? 0 : 1;
+    return stageDigitalOutputs(frame[1], 1, &setBits, &clearBits);
+  } else if (frame[0] == EXIOWRDM) {
+    uint8_t maskBytes = frame[2];
+    return stageDigitalOutputs(frame[1], maskBytes, &frame[3], &frame[3 + maskBytes]);
+  }
+  if (stagedOutputBytes + frameBytes + 1 > STAGED_OUTPUT_SIZE) {
+    logEvent(LOG_LATCH_FULL, frame[1], frame[0]);
+    return false;
+  }
+  stagedOutputs[stagedOutputBytes++] = frameBytes;
+  memcpy(&stagedOutputs[stagedOutputBytes], frame, frameBytes);
+  stagedOutputBytes += frameBytes;
+  return true;
+}
+
+/*
+* Function to apply all held outputs, digital outputs are written together first, then any
+* EXIOWRAN frames in the order they were received
+*/
+bool commitOutputs() {
+  bool response = commitDigitalOutputs();
+  uint8_t offset = 0;
+  while (offset < stagedOutputBytes) {
+    uint8_t frameBytes = stagedOutputs[offset];
+    if (!applyOutput(&stagedOutputs[offset + 1])) response = false;
+    offset += frameBytes + 1;
+  }
+  stagedOutputBytes = 0;
+  return response;
+}
+
+/*
+* Function to carry out a validated command frame
+*/
+bool executeCommand(byte* frame, uint8_t frameBytes) {
+  switch(frame[0]) {
+    case EXIOINIT:
+      outputLatch = false;
+      stagedOutputBytes = 0;
+      initialisePins();
+      return true;
+    case EXIODPUP:
+      return enableDigitalInput(frame[1], frame[2]);
+    case EXIOENAN:
+      return enableAnalogue(frame[1]);
+    case EXIOWRD:
+    case EXIOWRAN:
+    case EXIOWRDM:
+      if (outputLatch) {
+        return stageOutput(frame, frameBytes);
+      }
+      return applyOutput(frame);
+    case EXIOLATCH:
+      outputLatch = frame[1];
+      if (!outputLatch) {
+        return commitOutputs();   // Nothing is left held when latch mode is turned off
+      }
+      return true;
+    case EXIOCOMMIT:
+      return commitOutputs();
+    case EXIOCFG:
+      return configureInputs(frame[1], frame[2], &frame[3]);
+    case EXIOANENC:
+      return setAnalogueEncoding(frame[1]);
+    case EXIOBATCH: {
+      bool response = true;
+      uint8_t offset = 1;
+      while (offset < frameBytes) {
+        uint8_t commandBytes = batchCommandLength(frame[offset]);
+        if (commandBytes == 0 || offset + commandBytes > frameBytes) return false;
+        if (validateCommand(&frame[offset], commandBytes)) {
+          if (!executeCommand(&frame[offset], commandBytes)) response = false;
+        }
+        offset += commandBytes;
+      }
+      return response;
+    }
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,38 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMAND_FUNCTIONS_H
+#define COMMAND_FUNCTIONS_H
+
+#include <Arduino.h>
+#include "globals.h"
+
+bool validateCommand(byte* frame, uint8_t frameBytes);
+uint8_t validateBatch(byte* batch, uint8_t batchBytes, byte* status, uint8_t* numCommands);
+void failBatch(byte* status, uint8_t numCommands);
+uint8_t batchCommandLength(uint8_t command);
+bool commandQueueEmpty();
+bool queueCommand(byte* frame, uint8_t frameBytes);
+void processCommands();
+bool executeCommand(byte* frame, uint8_t frameBytes);
+bool applyOutput(byte* frame);
+bool stageOutput(byte* frame, uint8_t frameBytes);
+bool commitOutputs();
+
+#endif
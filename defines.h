@@ -31,22 +31,33 @@
 #define BOARD_TYPE F("Pro Mini")
 #endif
 #define TOTAL_PINS 18
+#define TOTAL_DIGITAL_PINS 16
+#define TOTAL_ANALOGUE_PINS 6
+#define TOTAL_PWM_PINS 6
 #define HAS_SERVO_LIB
 #define MAX_SUPERPINS 16
 #define HAS_EEPROM
 #define USE_FAST_WRITES
+#define SMALL_RAM_BOARD   // 2KB of RAM, buffers below are sized down
 //  Arduino Uno
 #elif defined(ARDUINO_AVR_UNO)
 #define BOARD_TYPE F("Uno")
 #define TOTAL_PINS 16
+#define TOTAL_DIGITAL_PINS 16
+#define TOTAL_ANALOGUE_PINS 4
+#define TOTAL_PWM_PINS 6
 #define HAS_SERVO_LIB
 #define MAX_SUPERPINS 16
 #define HAS_EEPROM
 #define USE_FAST_WRITES
+#define SMALL_RAM_BOARD
 //  Arduino Mega2560
 #elif defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_MEGA)
 #define BOARD_TYPE F("Mega")
 #define TOTAL_PINS 62
+#define TOTAL_DIGITAL_PINS 62
+#define TOTAL_ANALOGUE_PINS 16
+#define TOTAL_PWM_PINS 12
 #define HAS_SERVO_LIB
 #define MAX_SUPERPINS 62
 #define HAS_EEPROM
@@ -54,27 +65,87 @@
 #elif defined(ARDUINO_NUCLEO_F411RE)
 #define BOARD_TYPE F("Nucleo-F411RE")
 #define TOTAL_PINS 40
-#define NUM_PWM_PINS 25
+#define TOTAL_DIGITAL_PINS 40
+#define TOTAL_ANALOGUE_PINS 13
+#define TOTAL_PWM_PINS 25
 #define MAX_SUPERPINS 40
 #elif defined(ARDUINO_NUCLEO_F412ZG)
 #define BOARD_TYPE F("Nucleo-F412ZG")
 #define TOTAL_PINS 97
-#define NUM_PWM_PINS 40
+#define TOTAL_DIGITAL_PINS 97
+#define TOTAL_ANALOGUE_PINS 16
+#define TOTAL_PWM_PINS 41
 #define MAX_SUPERPINS 97
 #elif defined(ARDUINO_ARCH_SAMD)
 #define BOARD_TYPE F("Arduino Zero or Clone")
 #define TOTAL_PINS 27
-#define NUM_PWM_PINS 12
+#define TOTAL_DIGITAL_PINS 27
+#define TOTAL_ANALOGUE_PINS 6
+#define TOTAL_PWM_PINS 12
 #define MAX_SUPERPINS 27
 #elif defined(ARDUINO_BLUEPILL_F103C8)
 #define BOARD_TYPE F("BLUEPILL-STM32F103C8")
 #define TOTAL_PINS 28
-#define NUM_PWM_PINS 19
+#define TOTAL_DIGITAL_PINS 28
+#define TOTAL_ANALOGUE_PINS 10
+#define TOTAL_PWM_PINS 19
 #define MAX_SUPERPINS 28
 #else
 #define CPU_TYPE_ERROR
 #endif
 
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the pin state buffer sizes, these follow from the pin counts above which are
+//  checked against the board's pin map when the sketch is compiled
+//
+#define DIGITAL_PIN_BYTES ((TOTAL_DIGITAL_PINS + 7) / 8)
+#define DIGITAL_CHANGE_BYTES ((DIGITAL_PIN_BYTES + 7) / 8)
+#define ANALOGUE_PIN_BYTES (TOTAL_ANALOGUE_PINS * 2)  // Allocate for 16 bit, the largest encoding
+#define PIN_MASK_BYTES ((TOTAL_PINS + 7) / 8)
+#define PIN_LABEL_SIZE 5    // Longest pin label plus the terminating null
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the size of the received command queue in bytes, must be a power of 2 no more than 256
+//  Smaller on the Nano/Uno/Pro Mini to save RAM
+//
+#if defined(SMALL_RAM_BOARD)
+#define COMMAND_QUEUE_SIZE 64
+#else
+#define COMMAND_QUEUE_SIZE 128
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the number of digital input change events kept until read, must be a power of 2
+//  no more than 256, and the most events sent in one EXIORDEV response (5 bytes each)
+//
+#if defined(SMALL_RAM_BOARD)
+#define INPUT_EVENT_QUEUE_SIZE 16
+#else
+#define INPUT_EVENT_QUEUE_SIZE 64
+#endif
+#define MAX_EVENTS_PER_READ 6
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the number of error/event log entries kept, must be a power of 2 no more than 128,
+//  and the most entries sent in one EXIORDLOG response (4 bytes each)
+//
+#if defined(SMALL_RAM_BOARD)
+#define LOG_QUEUE_SIZE 8
+#else
+#define LOG_QUEUE_SIZE 32
+#endif
+#define MAX_LOG_PER_READ 7
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the bytes kept for output writes held in latch mode until EXIOCOMMIT, no more than 256
+//
+#if defined(SMALL_RAM_BOARD)
+#define STAGED_OUTPUT_SIZE 64
+#else
+#define STAGED_OUTPUT_SIZE 192
+#endif
+#define MAX_GPIO_PORTS 12   // Most GPIO ports read or written in one pass, covers the Mega's PORTA-PORTL
+
 /////////////////////////////////////////////////////////////////////////////////////
 //  Define serial interfaces here
 //
@@ -96,6 +167,94 @@
   #include "myConfig.example.h"
 #endif
 
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the SPI transport buffer size, longer frames and responses are truncated
+//
+#if defined(SPI_TRANSPORT)
+#if defined(SMALL_RAM_BOARD)
+#define SPI_BUFFER_SIZE 64
+#else
+#define SPI_BUFFER_SIZE 256
+#endif
+#if defined(ARDUINO_NUCLEO_F411RE) || defined(ARDUINO_NUCLEO_F412ZG)
+#define SPI_NSS_PIN PA4
+#endif
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the largest frame received by the DIRECT_I2C driver, no more than the 255 bytes
+//  processFrame() accepts, and the most separate parts of any response it sends
+//
+#if defined(DIRECT_I2C)
+#if defined(SMALL_RAM_BOARD)
+#define DIRECT_I2C_BUFFER_SIZE 64
+#else
+#define DIRECT_I2C_BUFFER_SIZE 255
+#endif
+#endif
+#define MAX_RESPONSE_SEGMENTS 4
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the UART transport packet format and defaults
+//
+#if defined(UART_TRANSPORT)
+#if defined(SPI_TRANSPORT)
+#error Only one of SPI_TRANSPORT and UART_TRANSPORT can be enabled
+#endif
+#ifndef UART_SERIAL
+#if defined(SMALL_RAM_BOARD)
+#error UART_TRANSPORT needs a second hardware serial port, define UART_SERIAL in myConfig.h
+#endif
+#define UART_SERIAL Serial1
+#endif
+#ifndef UART_BAUD
+#define UART_BAUD 115200
+#endif
+#if defined(SMALL_RAM_BOARD)
+#define UART_BUFFER_SIZE 64
+#else
+#define UART_BUFFER_SIZE 255
+#endif
+#define UART_START 0x7E         // First byte of every packet
+#define UART_PACKET_TIMEOUT 5   // ms between bytes before a partial packet is dropped
+#define UART_WAIT_START 0       // Packet receive states
+#define UART_ADDRESS 1
+#define UART_LENGTH 2
+#define UART_FRAME 3
+#define UART_CRC 4
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the largest response the transport can send in one read, input reads that don't
+//  fit are answered with EXIOERR rather than being cut short
+//  AVR Wire has a fixed 32 byte buffer and drops any write that doesn't fit in full, and no
+//  response is more than 255 bytes as they're counted in a uint8_t
+//
+#if defined(SPI_TRANSPORT) && SPI_BUFFER_SIZE < 255
+#define MAX_RESPONSE_BYTES SPI_BUFFER_SIZE
+#elif defined(SPI_TRANSPORT)
+#define MAX_RESPONSE_BYTES 255
+#elif defined(UART_TRANSPORT)
+#define MAX_RESPONSE_BYTES UART_BUFFER_SIZE
+#elif defined(ARDUINO_ARCH_AVR) && !defined(DIRECT_I2C)
+#define MAX_RESPONSE_BYTES 32
+#else
+#define MAX_RESPONSE_BYTES 255
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  I2C transports that accept writes to the general call address, set by enableGeneralCall()
+//  and Wire.begin() for Wire, and by the in-tree driver for DIRECT_I2C
+//  A general call EXIOCOMMIT writes held digital outputs in the I2C interrupt, so every device
+//  changes within microseconds of the others, provided each held pin was already a digital
+//  output and all held writes had been executed. Otherwise, and for held EXIOWRAN frames, the
+//  commit waits for the next loop(). DIRECT_I2C ignores anything else sent by general call,
+//  Wire can't tell general call frames apart so it processes them as if addressed to it.
+//
+#if !defined(SPI_TRANSPORT) && !defined(UART_TRANSPORT) && (defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32))
+#define I2C_GENERAL_CALL
+#endif
+
 /////////////////////////////////////////////////////////////////////////////////////
 //  Define data structures here
 //
@@ -108,15 +267,75 @@ struct pinDefinition {
 };
 
 /*
-Define the structure of the pin config
+Define the structure of the pin config, enable, direction and pullup are bitsets with one bit
+per pin so they can be checked a word at a time, and the byte sized fields are arrays by pin
 */
+#if defined(ARDUINO_ARCH_AVR)
+typedef uint8_t PinWord;
+#else
+typedef uint32_t PinWord;
+#endif
+#define PIN_WORD_BITS (sizeof(PinWord) * 8)
+#define PIN_WORDS ((TOTAL_PINS + PIN_WORD_BITS - 1) / PIN_WORD_BITS)
+#define pinWord(pin) ((pin) / PIN_WORD_BITS)
+#define pinBit(pin) ((PinWord)1 << ((pin) % PIN_WORD_BITS))
+#define pinBitRead(bits, pin) (((bits)[pinWord(pin)] & pinBit(pin)) != 0)
+#define pinBitWrite(bits, pin, value) ((value) ? ((bits)[pinWord(pin)] |= pinBit(pin)) : ((bits)[pinWord(pin)] &= ~pinBit(pin)))
+
 struct pinConfig {
-  uint8_t mode;             // 1 = digital, 2 = analogue, 3 = PWM, 4 = PWM LED
-  bool direction;           // 0 = output, 1 = input
-  bool pullup;              // 0 = no pullup, 1 = pullup (input only)
-  bool enable;              // 0 = disabled (default), 1 = enabled
-  uint8_t analogueLSBByte;  // Stores the byte number of the LSB byte in analoguePinStates
-  uint8_t servoIndex;       // Stores the servo or dimmer object array index used by the pin
+  PinWord enable[PIN_WORDS];        // 0 = disabled (default), 1 = enabled
+  PinWord direction[PIN_WORDS];     // 0 = output, 1 = input
+  PinWord pullup[PIN_WORDS];        // 0 = no pullup, 1 = pullup (input only)
+  uint8_t mode[TOTAL_PINS];         // 1 = digital, 2 = analogue, 3 = PWM, 4 = PWM LED
+  uint8_t analogueIndex[TOTAL_PINS];  // Analogue channel number used in analoguePinStates and analoguePinMap
+  uint8_t servoIndex[TOTAL_PINS];   // Servo or dimmer object array index used by the pin
+};
+
+/*
+Define the structure of a published input snapshot, two of these are used so
+requestEvent() always sends from a complete snapshot while the next one is prepared
+*/
+struct InputSnapshot {
+  byte* states;             // digitalPinBytes of digital states followed by analoguePinBytes of analogue states
+  byte inputBytes[2];       // Digital and analogue byte counts in states, sent ahead of EXIORDALL inputs
+  byte* changes;            // EXIORDDC response, changed byte bitmap followed by the changed digital bytes
+  uint8_t changeBytes;      // Number of bytes in changes to send
+  byte generation[2];       // inputGeneration when this snapshot was published, LSB first
+  uint8_t analogueEncoding; // analogueEncoding used for the analogue states
+  bool fullDelta;           // Flag changes contains every digital byte after initialisation
+};
+
+/*
+Define the type holding one GPIO port's pins, and the structure of a digital input in the
+precomputed scan list used by processInputs()
+*/
+#if defined(ARDUINO_ARCH_AVR)
+typedef uint8_t PortMask;
+#else
+typedef uint32_t PortMask;
+#endif
+
+struct InputScanPin {
+  uint8_t pin;              // Pin number
+  uint8_t port;             // Index of the port register in inputPortRegisters
+  PortMask mask;            // Bit of the pin in the port register
+};
+
+/*
+Define the structure of a digital input change event
+*/
+struct InputEvent {
+  uint8_t pinState;         // Pin number in bits 0-6, new state in bit 7
+  uint32_t timestamp;       // micros() at the scan the change was seen
+};
+
+/*
+Define the structure of an error/event log entry, rendered to text by processLogOutput()
+*/
+struct LogEntry {
+  uint8_t code;             // LOG_ code as defined below
+  uint8_t pin;              // Pin the entry is about, 255 if none
+  uint16_t arg;             // Any extra detail, depends on the code
 };
 
 /*
@@ -124,7 +343,7 @@ Define structure for a reverse pin map to display pin friendly names
 */
 struct pinName {
   uint8_t pinNumber;        // Pin number
-  String pinLabel;           // Pin name
+  char pinLabel[PIN_LABEL_SIZE];  // Pin name
 };
 
 /*
@@ -168,7 +387,116 @@ struct ServoData {
 #define EXIOINITA 0xE8    // Flag to send analogue pin info
 #define EXIOPINS 0xE9     // Flag we need to send pin counts
 #define EXIOWRAN 0xEA     // Flag we're receiving an analogue write (PWM)
+#define EXIORDDC 0xEB     // Flag only changed digital input bytes are being read
+#define EXIORDG 0xEC      // Flag inputs are being read only if the 16 bit generation has changed
+#define EXIORDALL 0xED    // Flag all digital and analogue inputs are being read together
+#define EXIOWRDM 0xEE     // Flag for a bulk digital write using set/clear masks
 #define EXIOERR 0xEF      // Flag something has errored to send to device driver
+#define EXIOBATCH 0xF0    // Flag we're receiving a batch of EXIOWRD/EXIOWRAN/EXIODPUP/EXIOENAN commands
+#define EXIOCFG 0xF1      // Flag we're receiving packed input configuration for a range of pins
+#define EXIOANENC 0xF2    // Flag we're receiving the analogue input encoding to use
+#define EXIORDANM 0xF3    // Flag only the analogue channels in a bitmask are being read
+#define EXIORDEV 0xF4     // Flag digital input change events are being read, acknowledging the last read
+#define EXIOREG 0xF5      // Flag we're receiving the register pointer for register map reads
+#define EXIOCOMMIT 0xF6   // Flag to apply outputs held in latch mode, may be sent to the general call address
+#define EXIOLATCH 0xF7    // Flag to enable or disable latch mode for output writes
+#define EXIOCAPS 0xF8     // Flag the capability descriptor is being read, from the given offset
+#define EXIORDLOG 0xF9    // Flag error/event log entries are being read
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the 2 bit per pin input configuration values used by EXIOCFG
+//
+#define CFG_NO_CHANGE 0x00      // Leave the pin as it is
+#define CFG_DIGITAL 0x01        // Digital input, no pullup
+#define CFG_DIGITAL_PULLUP 0x02 // Digital input with pullup
+#define CFG_ANALOGUE 0x03       // Analogue input
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the analogue input encodings selected by EXIOANENC
+//  16 bit is the default and is restored by EXIOINIT
+//  Packed 10 bit stores each group of 4 channels as 4 low bytes then 1 byte of the high 2 bits,
+//  a partial last group is padded with unused low bytes to a full 5 bytes
+//
+#define ANALOGUE_16BIT 0x00     // 2 bytes per channel, LSB then MSB
+#define ANALOGUE_8BIT 0x01      // 1 byte per channel, most significant 8 bits of the reading
+#define ANALOGUE_PACKED10 0x02  // 5 bytes per 4 channels or part of 4
+#define ANALOGUE_READ_BITS 10   // Resolution of analogRead()
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the maximum number of sub-commands in one EXIOBATCH frame, one status bit each
+//
+#define MAX_BATCH_COMMANDS 32
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the register map read with EXIOREG, reads start at the register pointer and
+//  return REGISTER_READ_BYTES consecutive registers, unused registers read as 0
+//
+#define REG_VERSION 0x00          // 3 bytes, major, minor, patch
+#define REG_NUM_PINS 0x03         // Total pins
+#define REG_NUM_DIGITAL 0x04      // Digital capable pins
+#define REG_NUM_ANALOGUE 0x05     // Analogue capable pins
+#define REG_DIGITAL_BYTES 0x06    // Bytes of digital states
+#define REG_ANALOGUE_BYTES 0x07   // Bytes of analogue states in the current encoding
+#define REG_ANALOGUE_ENC 0x08     // Analogue encoding
+#define REG_GENERATION 0x09       // Input generation LSB
+#define REG_STATUS 0x0A           // Status bits as below
+#define REG_EVENTS 0x0B           // Number of input change events waiting
+#define REG_GENERATION_MSB 0x0C   // Input generation MSB
+#define REG_DIGITAL 0x10          // Digital states, up to 128 pins
+#define REG_ANALOGUE 0x20         // Analogue states, up to 32 channels at 16 bit
+#define REG_ANALOGUE_MAP 0x60     // analoguePinMap, up to 32 channels
+#define REG_PIN_CONFIG 0x80       // One byte per pin, mode in bits 0-2, direction bit 4, pullup bit 5, enable bit 7
+#define REGISTER_READ_BYTES 32
+
+#define STATUS_SETUP_COMPLETE 0   // Status bit, EXIOINIT received with the correct pin count
+#define STATUS_ATTENTION 1        // Status bit, attention is asserted
+#define STATUS_EVENT_OVERFLOW 2   // Status bit, input change events have been dropped
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the capability descriptor read with EXIOCAPS, from the offset sent with it
+//  0     Descriptor length in bytes
+//  1     Descriptor format, CAPS_FORMAT
+//  2-4   Version, major, minor, patch
+//  5-8   Pins, digital pins, analogue pins, PWM pins
+//  9-10  Servos (0 if no servo library), SuperPins
+//  11-12 Feature bits as below, LSB first
+//  13-18 Command queue bytes, most batch sub-commands, input event queue, most events per
+//        EXIORDEV, staged output bytes, bytes per EXIOREG read
+//  19-   Pin capability values, 2 pins per byte with the lower numbered pin in the low nibble
+//
+#define CAPS_FORMAT 1
+#define CAPS_HEADER_BYTES 19
+#define CAPS_BYTES (CAPS_HEADER_BYTES + (TOTAL_PINS + 1) / 2)
+
+#define FEATURE_DELTA_READ 0      // EXIORDDC
+#define FEATURE_GENERATION_READ 1 // EXIORDG
+#define FEATURE_READ_ALL 2        // EXIORDALL
+#define FEATURE_BULK_WRITE 3      // EXIOWRDM
+#define FEATURE_BATCH 4           // EXIOBATCH
+#define FEATURE_CONFIGURE 5       // EXIOCFG
+#define FEATURE_ANALOGUE_ENC 6    // EXIOANENC, including ANALOGUE_PACKED10
+#define FEATURE_ANALOGUE_MASK 7   // EXIORDANM
+#define FEATURE_INPUT_EVENTS 8    // EXIORDEV
+#define FEATURE_REGISTER_MAP 9    // EXIOREG
+#define FEATURE_OUTPUT_LATCH 10   // EXIOLATCH and EXIOCOMMIT
+#define FEATURE_GENERAL_CALL 11   // EXIOCOMMIT is accepted on the I2C general call address
+#define FEATURE_ATTENTION 12      // ATTENTION_PIN is enabled
+#define FEATURE_SPI 13            // Running over SPI_TRANSPORT
+#define FEATURE_UART 14           // Running over UART_TRANSPORT
+#define FEATURE_LOG 15            // EXIORDLOG
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Define the error/event log codes
+//
+#define LOG_NOT_DIGITAL_INPUT 1   // Pin not capable of digital input
+#define LOG_NOT_DIGITAL_OUTPUT 2  // Pin not capable of digital output
+#define LOG_NOT_ANALOGUE 3        // Pin not capable of analogue input
+#define LOG_NOT_PWM 4             // Pin not capable of PWM output
+#define LOG_IN_USE_INPUT 5        // Pin already in use, cannot use as a digital input
+#define LOG_IN_USE_OUTPUT 6       // Pin already in use, cannot use as a digital output
+#define LOG_IN_USE_ANALOGUE 7     // Pin already in use, cannot use as an analogue input
+#define LOG_IN_USE_PWM 8          // Pin already in use, cannot use as a PWM output
+#define LOG_LATCH_FULL 9          // Latch mode output discarded, arg is the command
 
 /////////////////////////////////////////////////////////////////////////////////////
 //  Define version to store in EEPROM/FLASH in case this needs to change later
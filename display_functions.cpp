@@ -21,7 +21,8 @@
 #include "globals.h"
 #include "version.h"
 #include "display_functions.h"
-#include "i2c_functions.h"
+#include "protocol_functions.h"
+#include "pin_io_functions.h"
 
 char * version;   // Pointer for getting version
 uint8_t versionBuffer[3];   // Array to hold version info to send to device driver
@@ -53,46 +54,41 @@ void displayPins() {
   if (millis() - lastPinDisplay > displayDelay) {
     lastPinDisplay = millis();
     USB_SERIAL.println("Current pin states:");
-    for (uint8_t pin = 0; pin < numPins; pin++) {
-      String pinLabel = pinNameMap[pin].pinLabel;
-      if (pinLabel.length() == 1) {
-        pinLabel += "   ";
-      } else if (pinLabel.length() == 2) {
-        pinLabel += "  ";
-      } else if (pinLabel.length() == 3) {
-        pinLabel += " ";
+    if (scanEpoch != configEpoch) {
+      buildPinLists();
+    }
+    for (uint8_t enabled = 0; enabled < numEnabledPins; enabled++) {
+      uint8_t pin = enabledPins[enabled];
+      char pinLabel[PIN_LABEL_SIZE];
+      getPinLabel(pin, pinLabel);
+      uint8_t labelLength = strlen(pinLabel);
+      while (labelLength < PIN_LABEL_SIZE - 1) {
+        pinLabel[labelLength++] = ' ';
       }
-      switch(exioPins[pin].mode) {
-        case MODE_UNUSED: {
-          USB_SERIAL.print(F("Pin "));
-          USB_SERIAL.print(pinLabel);
-          USB_SERIAL.println(F(" not in use"));
-          break;
-        }
+      pinLabel[labelLength] = '\0';
+      switch(exioPins.mode[pin]) {
         case MODE_DIGITAL: {
           uint8_t dPinByte = pin / 8;
           uint8_t dPinBit = pin - dPinByte * 8;
           USB_SERIAL.print(F("Digital Pin|Direction|Pullup|State:"));
           USB_SERIAL.print(pinLabel);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print(exioPins[pin].direction);
+          USB_SERIAL.print(pinBitRead(exioPins.direction, pin));
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print(exioPins[pin].pullup);
+          USB_SERIAL.print(pinBitRead(exioPins.pullup, pin));
           USB_SERIAL.print(F("|"));
           USB_SERIAL.println(bitRead(digitalPinStates[dPinByte], dPinBit));
           break;
         }
         case MODE_ANALOGUE: {
-          uint8_t lsbByte = exioPins[pin].analogueLSBByte;
-          uint8_t msbByte = lsbByte + 1;
-          USB_SERIAL.print(F("Analogue Pin|Value|LSB|MSB:"));
+          USB_SERIAL.print(F("Analogue Pin|Channel|Encoding|Value:"));
           USB_SERIAL.print(pinLabel);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print((analoguePinStates[msbByte] << 8) + analoguePinStates[lsbByte]);
+          USB_SERIAL.print(exioPins.analogueIndex[pin]);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print(analoguePinStates[lsbByte]);
+          USB_SERIAL.print(analogueEncoding);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.println(analoguePinStates[msbByte]);
+          USB_SERIAL.println(readAnalogueState(exioPins.analogueIndex[pin]));
           break;
         }
         case MODE_PWM: {
@@ -101,7 +97,7 @@ void displayPins() {
           USB_SERIAL.print(F("PWM Output Pin|Servo|State:"));
           USB_SERIAL.print(pinLabel);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print(exioPins[pin].servoIndex);
+          USB_SERIAL.print(exioPins.servoIndex[pin]);
           USB_SERIAL.print(F("|"));
           USB_SERIAL.println(bitRead(digitalPinStates[dPinByte], dPinBit));
           break;
@@ -112,7 +108,7 @@ void displayPins() {
           USB_SERIAL.print(F("LED Output Pin|Servo|State:"));
           USB_SERIAL.print(pinLabel);
           USB_SERIAL.print(F("|"));
-          USB_SERIAL.print(exioPins[pin].servoIndex);
+          USB_SERIAL.print(exioPins.servoIndex[pin]);
           USB_SERIAL.print(F("|"));
           USB_SERIAL.println(bitRead(digitalPinStates[dPinByte], dPinBit));
           break;
@@ -121,6 +117,8 @@ void displayPins() {
           break;
       }
     }
+    USB_SERIAL.print(numPins - numEnabledPins);
+    USB_SERIAL.println(F(" other pins not in use"));
   }
 }
 
@@ -142,10 +140,11 @@ void displayVpinMap() {
     } else {
       USB_SERIAL.print(F(" => "));
     }
-    String pinLabel = pinNameMap[pin].pinLabel;
-    if (pinLabel.length() < 3) {
+    char pinLabel[PIN_LABEL_SIZE];
+    getPinLabel(pin, pinLabel);
+    if (strlen(pinLabel) < 3) {
       USB_SERIAL.print(F("  "));
-    } else if (pinLabel.length() < 4) {
+    } else if (strlen(pinLabel) < 4) {
       USB_SERIAL.print(F(" "));
     }
     USB_SERIAL.print(pinLabel);
@@ -185,21 +184,70 @@ void processDisplayOutput() {
       break;
     case EXIODPUP:
       if(diag) {
-        USB_SERIAL.println(F("EXIODPUP received with incorrect number of bytes"));
+        USB_SERIAL.println(F("EXIODPUP received with invalid pin or incorrect number of bytes"));
       }
       displayEvent = 0x00;
       displayEventFlag = 0;
       break;
     case EXIOWRD:
       if(diag) {
-        USB_SERIAL.println(F("EXIOWRD received with incorrect number of bytes"));
+        USB_SERIAL.println(F("EXIOWRD received with invalid pin or incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOWRDM:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOWRDM received with invalid pin or incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOCFG:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOCFG received with invalid pin or incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOBATCH:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOBATCH received with an invalid sub-command or length"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOANENC:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOANENC received with invalid encoding or incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOLATCH:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOLATCH received with invalid setting or incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOCOMMIT:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOCOMMIT received with incorrect number of bytes"));
+      }
+      displayEvent = 0x00;
+      displayEventFlag = 0;
+      break;
+    case EXIOENAN:
+      if(diag) {
+        USB_SERIAL.println(F("EXIOENAN received with invalid pin or incorrect number of bytes"));
       }
       displayEvent = 0x00;
       displayEventFlag = 0;
       break;
     case EXIOWRAN:
       if(diag) {
-        USB_SERIAL.println(F("EXIOWRD received with incorrect number of bytes"));
+        USB_SERIAL.println(F("EXIOWRAN received with invalid pin or incorrect number of bytes"));
       }
       displayEvent = 0x00;
       displayEventFlag = 0;
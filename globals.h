@@ -28,29 +28,48 @@
 #endif
 #include "SuperPin.h"
 
-extern pinDefinition pinMap[TOTAL_PINS];
-extern pinName pinNameMap[TOTAL_PINS];
-extern pinConfig exioPins[TOTAL_PINS];
+extern const pinDefinition pinMap[TOTAL_PINS];
+extern const pinName pinNameMap[TOTAL_PINS];
+extern pinConfig exioPins;
 extern uint8_t i2cAddress;
 extern uint8_t numPins;
-extern uint8_t numDigitalPins;
-extern uint8_t numAnaloguePins;
-extern uint8_t numPWMPins;
+extern const uint8_t numDigitalPins;
+extern const uint8_t numAnaloguePins;
+extern const uint8_t numPWMPins;
 extern int analoguePinBytes;
-extern int digitalPinBytes;
-extern byte* digitalPinStates;
-extern byte* analoguePinStates;
+extern uint8_t analogueEncoding;
+extern uint8_t activeAnaloguePins[TOTAL_ANALOGUE_PINS];
+extern uint8_t numActiveAnaloguePins;
+extern byte analogueSelectBuffer[ANALOGUE_PIN_BYTES];
+extern const int digitalPinBytes;
+extern byte digitalPinStates[DIGITAL_PIN_BYTES];
+extern byte analoguePinStates[ANALOGUE_PIN_BYTES];
+extern const int digitalChangeBytes;
+extern uint16_t inputGeneration;
+extern InputSnapshot inputSnapshots[2];
+extern volatile uint8_t frontSnapshot;
+extern volatile int8_t streamingSnapshot;
+extern volatile bool deltaSent;
+extern volatile uint8_t deltaSentSnapshot;
+extern volatile bool attentionActive;
+extern volatile InputEvent inputEvents[INPUT_EVENT_QUEUE_SIZE];
+extern volatile uint8_t inputEventHead;
+extern volatile uint8_t inputEventTail;
+extern volatile uint8_t inputEventsDropped;
+extern volatile uint8_t inputEventsDroppedAcked;
+extern volatile uint8_t stagedEventCount;
+extern volatile uint8_t stagedEventsDropped;
 extern uint8_t versionBuffer[3];
 extern unsigned long displayDelay;
 extern uint16_t firstVpin;
 extern bool diag;
 extern bool setupComplete;
-extern uint8_t* analoguePinMap;
+extern uint8_t analoguePinMap[TOTAL_ANALOGUE_PINS];
 extern bool analogueTesting;
 extern bool inputTesting;
 extern bool outputTesting;
 extern bool pullupTesting;
-extern ServoData** servoDataArray;
+extern ServoData* servoDataArray[TOTAL_PINS];
 #if defined(HAS_SERVO_LIB)
 extern Servo servoMap[MAX_SERVOS];
 #endif
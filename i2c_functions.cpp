@@ -18,21 +18,14 @@
  */
 
 #include <Arduino.h>
-#include <Wire.h>
 #include "globals.h"
+#if !defined(DIRECT_I2C)
+#include <Wire.h>
+#endif
 #include "i2c_functions.h"
-#include "display_functions.h"
-#include "pin_io_functions.h"
-
-uint8_t numAnaloguePins = 0;  // Init with 0, will be overridden by config
-uint8_t numDigitalPins = 0;   // Init with 0, will be overridden by config
-uint8_t numPWMPins = 0;  // Number of PWM capable pins
-bool setupComplete = false;   // Flag when initial configuration/setup has been received
-uint8_t outboundFlag;   // Used to determine what data to send back to the CommandStation
-byte commandBuffer[3];    // Command buffer to interact with device driver
-byte responseBuffer[1];   // Buffer to send single response back to device driver
-uint8_t numReceivedPins = 0;
+#include "protocol_functions.h"
 
+#if !defined(DIRECT_I2C)
 /*
 * Function triggered when CommandStation is sending data to this device.
 */
@@ -44,168 +37,262 @@ void receiveEvent(int numBytes) {
   for (uint8_t byte = 0; byte < numBytes; byte++) {
     buffer[byte] = Wire.read();   // Read all received bytes into our buffer array
   }
-  switch(buffer[0]) {
-    // Initial configuration start, must be 2 bytes
-    case EXIOINIT:
-      if (numBytes == 4) {
-        initialisePins();
-        numReceivedPins = buffer[1];
-        firstVpin = (buffer[3] << 8) + buffer[2];
-        if (numReceivedPins == numPins) {
-          displayEventFlag = 0;
-          setupComplete = true;
-        } else {
-          displayEventFlag = 1;
-          setupComplete = false;
-        }
-        outboundFlag = EXIOINIT;
-        displayEvent = EXIOINIT;
-      } else {
-        displayEventFlag = 2;
-      }
-      break;
-    case EXIOINITA:
-      if (numBytes == 1) {
-        outboundFlag = EXIOINITA;
-      } else {
-        displayEvent = EXIOINITA;
-      }
-      break;
-    // Flag to set digital pin pullups, 0 disabled, 1 enabled
-    case EXIODPUP:
-      outboundFlag = EXIODPUP;
-      if (numBytes == 3) {
-        uint8_t pin = buffer[1];
-        bool pullup = buffer[2];
-        bool response = enableDigitalInput(pin, pullup);
-        if (response) {
-          responseBuffer[0] = EXIORDY;
-        } else {
-          responseBuffer[0] = EXIOERR;
-        }
-      } else {
-        displayEvent = EXIODPUP;
-        responseBuffer[0] = EXIOERR;
-      }
-      break;
-    case EXIORDAN:
-      if (numBytes == 1) {
-        outboundFlag = EXIORDAN;
-      }
-      break;
-    case EXIOWRD:
-      outboundFlag = EXIOWRD;
-      if (numBytes == 3) {
-        uint8_t pin = buffer[1];
-        bool state = buffer[2];
-        bool response = writeDigitalOutput(pin, state);
-        if (response) {
-          responseBuffer[0] = EXIORDY;
-        } else {
-          responseBuffer[0] = EXIOERR;
-        }
-      } else {
-        displayEvent = EXIOWRD;
-        responseBuffer[0] = EXIOERR;        
-      }
-      break;
-    case EXIORDD:
-      if (numBytes == 1) {
-        outboundFlag = EXIORDD;
-      }
-      break;
-    case EXIOVER:
-      if (numBytes == 1) {
-        outboundFlag = EXIOVER;
-      }
-      break;
-    case EXIOENAN:
-      outboundFlag = EXIOENAN;
-      if (numBytes == 2) {
-        uint8_t pin = buffer[1];
-        bool response = enableAnalogue(pin);
-        if (response) {
-          responseBuffer[0] = EXIORDY;
-        } else {
-          responseBuffer[0] = EXIOERR;
-        }
-      } else {
-        responseBuffer[0] = EXIOERR;
-      }
-      break;
-    case EXIOWRAN:
-      outboundFlag = EXIOWRAN;
-      if (numBytes == 7) {
-        uint8_t pin = buffer[1];
-        uint16_t value = (buffer[3] << 8) + buffer[2];
-        uint8_t profile = buffer[4];
-        uint16_t duration = (buffer[6] << 8) + buffer[5];
-        bool response = writeAnalogue(pin, value, profile, duration);
-        if (response) {
-          responseBuffer[0] = EXIORDY;
-        } else {
-          responseBuffer[0] = EXIOERR;
-        }
-      } else {
-        displayEvent = EXIOWRAN;
-        responseBuffer[0] = EXIOERR;
-      }
-      break;
-    default:
-      break;
-  }
+  processFrame(buffer, numBytes);
 }
 
 /*
 * Function triggered when CommandStation polls for inputs on this device.
 */
 void requestEvent() {
-  switch(outboundFlag) {
-    case EXIOINIT:
-      if (setupComplete) {
-        commandBuffer[0] = EXIOPINS;
-        commandBuffer[1] = numDigitalPins;
-        commandBuffer[2] = numAnaloguePins;
-      } else {
-        commandBuffer[0] = 0;
-        commandBuffer[1] = 0;
-        commandBuffer[2] = 0;
-      }
-      Wire.write(commandBuffer, 3);
-      break;
-    case EXIOINITA:
-      Wire.write(analoguePinMap, numAnaloguePins);
+  writeResponse(wireWrite);
+}
+
+/*
+* Function to add part of the response to the Wire transmit buffer
+*/
+void wireWrite(const byte* data, uint8_t bytes) {
+  Wire.write(data, bytes);
+}
+
+/*
+* Function to also accept writes sent to the general call address so a single EXIOCOMMIT
+* broadcast applies held outputs on every device at once
+* STM32 enables it by passing true to Wire.begin() in setup(), other platforms only accept
+* EXIOCOMMIT sent to their own address
+*/
+void enableGeneralCall() {
+#if defined(ARDUINO_ARCH_AVR)
+  TWAR |= _BV(TWGCE);
+#endif
+}
+
+void disableWire() {
+#ifdef WIRE_HAS_END
+  Wire.end();
+#else
+  USB_SERIAL.println(F("WARNING! The Wire.h library has no end() function, ensure EX-IOExpander is disconnected from your CommandStation"));
+#endif
+}
+
+#else
+/*
+* Optional in-tree I2C slave driver, enabled with DIRECT_I2C in myConfig.h, used instead of
+* Wire. Received frames are limited by DIRECT_I2C_BUFFER_SIZE rather than the Wire buffer, and
+* responses are sent straight from the snapshot and staged buffers writeResponse() points at,
+* one byte per interrupt, without copying them anywhere first.
+* The snapshot being sent is held in streamingSnapshot so publishInputs() won't overwrite it.
+*/
+byte i2cRxBuffer[DIRECT_I2C_BUFFER_SIZE];   // Frame being received
+uint8_t i2cRxBytes = 0;
+bool i2cGeneralCall = false;  // Flag the frame being received was sent to the general call address
+const byte* i2cSegments[MAX_RESPONSE_SEGMENTS];  // Parts of the response being sent, in order
+uint8_t i2cSegmentBytes[MAX_RESPONSE_SEGMENTS];
+uint8_t i2cNumSegments = 0;
+uint8_t i2cSegment = 0;   // Part of the response currently being sent
+uint8_t i2cSegmentIndex = 0;  // Next byte to send from the current part
+
+/*
+* Function to record part of the response without copying it
+*/
+void directWrite(const byte* data, uint8_t bytes) {
+  if (i2cNumSegments < MAX_RESPONSE_SEGMENTS && bytes > 0) {
+    i2cSegments[i2cNumSegments] = data;
+    i2cSegmentBytes[i2cNumSegments] = bytes;
+    i2cNumSegments++;
+  }
+}
+
+/*
+* Function called when the CommandStation starts a read, points at the response to send
+*/
+void startResponse() {
+  streamingSnapshot = frontSnapshot;
+  i2cNumSegments = 0;
+  i2cSegment = 0;
+  i2cSegmentIndex = 0;
+  writeResponse(directWrite);
+}
+
+/*
+* Function to return the next response byte, 0 once the response is complete
+*/
+byte nextResponseByte() {
+  while (i2cSegment < i2cNumSegments) {
+    if (i2cSegmentIndex < i2cSegmentBytes[i2cSegment]) {
+      return i2cSegments[i2cSegment][i2cSegmentIndex++];
+    }
+    i2cSegment++;
+    i2cSegmentIndex = 0;
+  }
+  return 0;
+}
+
+/*
+* Function to check if there are more response bytes to send
+*/
+bool moreResponseBytes() {
+  return i2cSegment < i2cNumSegments &&
+    (i2cSegmentIndex < i2cSegmentBytes[i2cSegment] || i2cSegment + 1 < i2cNumSegments);
+}
+
+/*
+* Function called at the end of a received frame, only EXIOCOMMIT is accepted by general call
+*/
+void endReceivedFrame() {
+  if (i2cGeneralCall && (i2cRxBytes != 1 || i2cRxBuffer[0] != EXIOCOMMIT)) {
+    i2cRxBytes = 0;
+  }
+  if (i2cRxBytes > 0) {
+    processFrame(i2cRxBuffer, i2cRxBytes);
+    i2cRxBytes = 0;
+  }
+}
+
+/*
+* Function to store a received byte, returns false if the frame is too long
+*/
+bool receiveByte(byte received) {
+  if (i2cRxBytes < DIRECT_I2C_BUFFER_SIZE) {
+    i2cRxBuffer[i2cRxBytes++] = received;
+    return true;
+  }
+  return false;
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+#include <util/twi.h>
+
+#define TWI_ACK (_BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA))
+#define TWI_NACK (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+/*
+* Function to start the TWI in slave mode, answering the general call address as well
+*/
+void setupDirectI2C(uint8_t address) {
+#if !defined(DISABLE_I2C_PULLUPS)
+  digitalWrite(SDA, HIGH);  // Internal pullups, as Wire.begin() does
+  digitalWrite(SCL, HIGH);
+#endif
+  TWAR = (address << 1) | _BV(TWGCE);
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+}
+
+void disableWire() {
+  TWCR = 0;
+}
+
+ISR(TWI_vect) {
+  switch(TW_STATUS) {
+    // Start of a write, any frame not ended by a stop is dropped
+    case TW_SR_SLA_ACK:
+    case TW_SR_ARB_LOST_SLA_ACK:
+      i2cRxBytes = 0;
+      i2cGeneralCall = false;
+      TWCR = TWI_ACK;
       break;
-    case EXIORDAN:
-      Wire.write(analoguePinStates, analoguePinBytes);
+    case TW_SR_GCALL_ACK:
+    case TW_SR_ARB_LOST_GCALL_ACK:
+      i2cRxBytes = 0;
+      i2cGeneralCall = true;
+      TWCR = TWI_ACK;
       break;
-    case EXIORDD:
-      Wire.write(digitalPinStates, digitalPinBytes);
+    case TW_SR_DATA_ACK:
+    case TW_SR_GCALL_DATA_ACK:
+      TWCR = receiveByte(TWDR) ? TWI_ACK : TWI_NACK;
       break;
-    case EXIOVER:
-      Wire.write(versionBuffer, 3);
+    // Stop or repeated start, the frame is complete
+    case TW_SR_STOP:
+      TWCR = TWI_ACK;
+      endReceivedFrame();
       break;
-    case EXIODPUP:
-      Wire.write(responseBuffer, 1);
+    // Start of a read, send the first byte
+    case TW_ST_SLA_ACK:
+    case TW_ST_ARB_LOST_SLA_ACK:
+      startResponse();
+      TWDR = nextResponseByte();
+      TWCR = moreResponseBytes() ? TWI_ACK : TWI_NACK;
       break;
-    case EXIOENAN:
-      Wire.write(responseBuffer, 1);
+    case TW_ST_DATA_ACK:
+      TWDR = nextResponseByte();
+      TWCR = moreResponseBytes() ? TWI_ACK : TWI_NACK;
       break;
-    case EXIOWRAN:
-      Wire.write(responseBuffer, 1);
+    // End of a read
+    case TW_ST_DATA_NACK:
+    case TW_ST_LAST_DATA:
+      streamingSnapshot = -1;
+      TWCR = TWI_ACK;
       break;
-    case EXIOWRD:
-      Wire.write(responseBuffer, 1);
+    case TW_BUS_ERROR:
+      streamingSnapshot = -1;
+      TWCR = TWI_ACK | _BV(TWSTO);
       break;
     default:
+      TWCR = TWI_ACK;
       break;
   }
 }
 
+#elif defined(ARDUINO_ARCH_STM32)
+/*
+* Function to start I2C1 in slave mode on the default SDA and SCL pins, answering the general
+* call address as well
+*/
+void setupDirectI2C(uint8_t address) {
+  pinmap_pinout(digitalPinToPinName(SDA), PinMap_I2C_SDA);
+  pinmap_pinout(digitalPinToPinName(SCL), PinMap_I2C_SCL);
+  __HAL_RCC_I2C1_CLK_ENABLE();
+  __HAL_RCC_I2C1_FORCE_RESET();
+  __HAL_RCC_I2C1_RELEASE_RESET();
+  I2C1->CR2 = (HAL_RCC_GetPCLK1Freq() / 1000000) | I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN;
+  I2C1->OAR1 = (1 << 14) | (address << 1);  // Bit 14 must be kept set
+  I2C1->CR1 = I2C_CR1_PE | I2C_CR1_ENGC;
+  I2C1->CR1 |= I2C_CR1_ACK;   // ACK can only be set once the peripheral is enabled
+  HAL_NVIC_SetPriority(I2C1_EV_IRQn, 0, 0);
+  HAL_NVIC_SetPriority(I2C1_ER_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+  HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+}
+
 void disableWire() {
-#ifdef WIRE_HAS_END
-  Wire.end();
+  HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+  HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
+  I2C1->CR1 = 0;
+}
+
+extern "C" void I2C1_EV_IRQHandler(void) {
+  uint32_t status = I2C1->SR1;
+  if (status & I2C_SR1_ADDR) {
+    uint32_t status2 = I2C1->SR2;   // Reading SR2 after SR1 clears ADDR
+    if (status2 & I2C_SR2_TRA) {
+      endReceivedFrame();   // A repeated start has no stop, so end any write before it here
+      startResponse();
+    } else {
+      i2cRxBytes = 0;
+      i2cGeneralCall = status2 & I2C_SR2_GENCALL;
+    }
+  }
+  if (status & I2C_SR1_RXNE) {
+    receiveByte(I2C1->DR);
+  }
+  if (status & I2C_SR1_TXE) {
+    I2C1->DR = nextResponseByte();
+  }
+  if (status & I2C_SR1_STOPF) {
+    I2C1->CR1 |= I2C_CR1_PE;    // Writing CR1 after reading SR1 clears STOPF
+    endReceivedFrame();
+  }
+}
+
+extern "C" void I2C1_ER_IRQHandler(void) {
+  // The CommandStation NACKs the last byte it wants, which ends a read
+  if (I2C1->SR1 & I2C_SR1_AF) {
+    streamingSnapshot = -1;
+  }
+  I2C1->SR1 &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR);
+}
+
 #else
-  USB_SERIAL.println(F("WARNING! The Wire.h library has no end() function, ensure EX-IOExpander is disconnected from your CommandStation"));
+#error DIRECT_I2C is only supported on AVR and STM32 boards
+#endif
+
 #endif
-}
\ No newline at end of file
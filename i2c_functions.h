@@ -23,10 +23,20 @@
 #include <Arduino.h>
 #include "globals.h"
 
-extern uint8_t numReceivedPins;
-
+#if !defined(DIRECT_I2C)
 void receiveEvent(int numBytes);
 void requestEvent();
+void wireWrite(const byte* data, uint8_t bytes);
+void enableGeneralCall();
+#else
+void directWrite(const byte* data, uint8_t bytes);
+void startResponse();
+byte nextResponseByte();
+bool moreResponseBytes();
+void endReceivedFrame();
+bool receiveByte(byte received);
+void setupDirectI2C(uint8_t address);
+#endif
 void disableWire();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,116 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+* Errors found while configuring or writing pins are logged as small binary entries rather than
+* printed where they happen, so logging costs the same whatever the serial port is doing.
+* processLogOutput() renders new entries to text from loop(), and the CommandStation can read
+* them with EXIORDLOG. Each reader has its own tail, and when the log wraps the oldest entries
+* are overwritten and counted as lost by any reader that hadn't reached them.
+* Entries are only added from loop(), the slot being written is never sent by EXIORDLOG.
+*/
+
+#include <Arduino.h>
+#include "globals.h"
+#include "log_functions.h"
+#include "pin_io_functions.h"
+
+LogEntry logEntries[LOG_QUEUE_SIZE];
+volatile uint8_t logHead = 0;   // Count of entries ever logged, wrapping, only written by logEvent()
+uint8_t logDisplayTail = 0;     // Next entry for processLogOutput() to render
+volatile uint8_t logReadTail = 0;   // Next entry for EXIORDLOG to send
+
+/*
+* Function to add an entry to the log
+*/
+void logEvent(uint8_t code, uint8_t pin, uint16_t arg) {
+  LogEntry* entry = &logEntries[logHead & (LOG_QUEUE_SIZE - 1)];
+  entry->code = code;
+  entry->pin = pin;
+  entry->arg = arg;
+  logHead++;  // Publish the entry only once it's complete
+}
+
+/*
+* Function to render any new log entries to the serial console, called from loop()
+*/
+void processLogOutput() {
+  uint8_t head = logHead;
+  uint8_t pending = head - logDisplayTail;
+  if (pending > LOG_QUEUE_SIZE - 1) {
+    USB_SERIAL.print(F("WARNING! "));
+    USB_SERIAL.print(pending - (LOG_QUEUE_SIZE - 1));
+    USB_SERIAL.println(F(" log entries lost"));
+    logDisplayTail = head - (LOG_QUEUE_SIZE - 1);
+  }
+  while (logDisplayTail != head) {
+    LogEntry entry = logEntries[logDisplayTail & (LOG_QUEUE_SIZE - 1)];
+    logDisplayTail++;
+    displayLogEntry(&entry);
+  }
+}
+
+/*
+* Function to display a single log entry as text
+*/
+void displayLogEntry(LogEntry* entry) {
+  if (entry->code == LOG_LATCH_FULL) {
+    USB_SERIAL.println(F("ERROR! Too many outputs held in latch mode, write discarded"));
+    return;
+  }
+  if (entry->code == LOG_NOT_PWM) {
+    USB_SERIAL.print(F("ERROR! Pin "));
+    char pinLabel[PIN_LABEL_SIZE];
+    getPinLabel(entry->pin, pinLabel);
+    USB_SERIAL.print(pinLabel);
+  } else {
+    USB_SERIAL.print(F("ERROR! pin "));
+    USB_SERIAL.print(pinMap[entry->pin].physicalPin);
+  }
+  switch(entry->code) {
+    case LOG_NOT_DIGITAL_INPUT:
+      USB_SERIAL.println(F(" not capable of digital input"));
+      break;
+    case LOG_NOT_DIGITAL_OUTPUT:
+      USB_SERIAL.println(F(" not capable of digital output"));
+      break;
+    case LOG_NOT_ANALOGUE:
+      USB_SERIAL.println(F(" not capable of analogue input"));
+      break;
+    case LOG_NOT_PWM:
+      USB_SERIAL.println(F(" not capable of PWM output"));
+      break;
+    case LOG_IN_USE_INPUT:
+      USB_SERIAL.println(F(" already in use, cannot use as a digital input pin"));
+      break;
+    case LOG_IN_USE_OUTPUT:
+      USB_SERIAL.println(F(" already in use, cannot use as a digital output pin"));
+      break;
+    case LOG_IN_USE_ANALOGUE:
+      USB_SERIAL.println(F(" already in use, cannot use as an analogue input pin"));
+      break;
+    case LOG_IN_USE_PWM:
+      USB_SERIAL.println(F(" already in use, cannot use as a PWM output pin"));
+      break;
+    default:
+      USB_SERIAL.print(F(" error code "));
+      USB_SERIAL.println(entry->code);
+      break;
+  }
+}
@@ -41,6 +41,38 @@
 // #define TEST_MODE OUTPUT_TEST
 // #define TEST_MODE PULLUP_TEST
 
+/////////////////////////////////////////////////////////////////////////////////////
+//  Uncomment to enable an attention output that is pulled low when any digital input
+//  changes, and released when the CommandStation reads the inputs.
+//  This is open drain so the attention pins of multiple devices can be connected together.
+//  NOTE: This pin must not be configured for use by the CommandStation
+// #define ATTENTION_PIN 2
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Uncomment to use the built in I2C slave driver instead of the Wire library, which accepts
+//  frames longer than the Wire buffer and sends responses without copying them
+//  Supported on AVR and STM32 (I2C1) boards only
+// #define DIRECT_I2C
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Uncomment to use SPI instead of I2C to communicate with the CommandStation
+//  Each transaction sends one command and returns the response to the previous command
+//  AVR: SS, SCK, MOSI and MISO (D10-D13 on the Nano/Uno), keep the SPI clock at 1MHz or less
+//  STM32F4 Nucleo: PA4 (NSS), PA5 (SCK), PA6 (MISO) and PA7 (MOSI), using DMA
+//  NOTE: These pins must not be configured for use by the CommandStation
+// #define SPI_TRANSPORT
+
+/////////////////////////////////////////////////////////////////////////////////////
+//  Uncomment to use a UART, such as an RS-485 multidrop bus, instead of I2C to communicate
+//  with the CommandStation, the device address is the I2C address above
+//  UART_SERIAL defaults to Serial1, the Nano/Uno/Pro Mini have no second serial port
+//  RS485_DE_PIN is driven high only while replying, to enable the RS-485 driver
+//  NOTE: These pins must not be configured for use by the CommandStation
+// #define UART_TRANSPORT
+// #define UART_SERIAL Serial1
+// #define UART_BAUD 115200
+// #define RS485_DE_PIN 2
+
 /////////////////////////////////////////////////////////////////////////////////////
 //  Uncomment to disable internal I2C pullup resistors
 //  NOTE: This will not apply to all supported devices, refer to the documentation
@@ -21,66 +21,139 @@
 #include "globals.h"
 #include "pin_io_functions.h"
 #include "servo_functions.h"
+#include "log_functions.h"
 
-pinConfig exioPins[TOTAL_PINS];
-int digitalPinBytes = 0;  // Used for configuring and sending/receiving digital pins
-int analoguePinBytes = 0; // Used for sending analogue 16 bit values
-byte* digitalPinStates;   // Store digital pin states to send to device driver
-byte* analoguePinStates;  // Store analogue pin states to send to device driver
+pinConfig exioPins;
+const int digitalPinBytes = DIGITAL_PIN_BYTES;  // Used for configuring and sending/receiving digital pins
+int analoguePinBytes = ANALOGUE_PIN_BYTES; // Used for sending analogue values, depends on analogueEncoding
+uint8_t analogueEncoding = ANALOGUE_16BIT; // Encoding used for analoguePinStates
+uint8_t activeAnaloguePins[TOTAL_ANALOGUE_PINS];  // Pins enabled as analogue inputs, in the order they're sampled
+uint8_t numActiveAnaloguePins = 0;
+byte digitalPinStates[DIGITAL_PIN_BYTES];   // Store digital pin states to send to device driver
+byte analoguePinStates[ANALOGUE_PIN_BYTES];  // Store analogue pin states to send to device driver
+const int digitalChangeBytes = DIGITAL_CHANGE_BYTES; // Number of bytes in the changed byte bitmap
+byte sentDigitalStates[DIGITAL_PIN_BYTES];  // Digital states last sent by EXIORDDC, used to find changed bytes
+bool resyncDigital = true;  // Flag the next EXIORDDC must send every digital byte
+uint16_t inputGeneration = 0;  // Incremented by each publishInputs() that publishes a change
+bool inputsChanged = true;    // Flag digitalPinStates or analoguePinStates changed since the last publish
+InputSnapshot inputSnapshots[2];  // Published snapshots, requestEvent() only reads from the front one
+byte snapshotStates[2][DIGITAL_PIN_BYTES + ANALOGUE_PIN_BYTES];  // Storage for each snapshot's states
+byte snapshotChanges[2][DIGITAL_CHANGE_BYTES + DIGITAL_PIN_BYTES];  // Storage for each snapshot's changes
+volatile uint8_t frontSnapshot = 0; // Index of the snapshot requestEvent() sends from
+volatile int8_t streamingSnapshot = -1; // Snapshot a response is being sent from in place, -1 if none
+volatile bool deltaSent = false;  // Flag an EXIORDDC response has been sent since the last publish
+volatile uint8_t deltaSentSnapshot = 0; // Index of the snapshot the last EXIORDDC response was sent from
+volatile InputEvent inputEvents[INPUT_EVENT_QUEUE_SIZE];  // Digital input changes waiting for EXIORDEV
+volatile uint8_t inputEventHead = 0;  // Next free event, only written by processInputs()
+volatile uint8_t inputEventTail = 0;  // Next event to send, only written by EXIORDEV
+volatile uint8_t inputEventsDropped = 0;  // Running count of dropped events, only written by loop()
+volatile uint8_t inputEventsDroppedAcked = 0; // inputEventsDropped last acknowledged, only written by EXIORDEV
+volatile uint8_t stagedEventCount = 0;    // Events sent by the last EXIORDEV response, removed once acknowledged
+volatile uint8_t stagedEventsDropped = 0; // inputEventsDropped when the last EXIORDEV response was staged
+volatile bool attentionActive = false;  // Flag the attention pin is asserted until inputs are read
+volatile bool attentionReleased = false;  // Flag inputs have been read, for loop() to release attention
+bool attentionPending = false;  // Flag a digital input changed, attention is asserted once it's published
+byte stagedSetMask[PIN_MASK_BYTES];    // Digital outputs to set high on the next commitDigitalOutputs(), one bit per pin
+byte stagedClearMask[PIN_MASK_BYTES];  // Digital outputs to set low on the next commitDigitalOutputs(), one bit per pin
+bool digitalOutputsStaged = false;  // Flag either staged mask has a bit set
+#if defined(USE_FAST_WRITES)
+volatile uint8_t* commitPortRegisters[MAX_GPIO_PORTS];  // Output ports written by a commit
+uint8_t commitPortSet[MAX_GPIO_PORTS];
+uint8_t commitPortClear[MAX_GPIO_PORTS];
+#elif defined(ARDUINO_ARCH_STM32)
+GPIO_TypeDef* commitPortRegisters[MAX_GPIO_PORTS];
+uint32_t commitPortSet[MAX_GPIO_PORTS];
+uint32_t commitPortClear[MAX_GPIO_PORTS];
+#endif
+uint8_t numCommitPorts = 0;
+volatile bool directCommitReady = false;  // Flag the commit ports hold every staged output, see prepareDigitalCommit()
 unsigned long lastOutputTest = 0; // Delay for output testing
+uint8_t configEpoch = 0;  // Incremented by pinConfigChanged() whenever any pin's configuration changes
+uint8_t scanEpoch = 0;    // configEpoch the pin lists were last built for
+uint8_t enabledPins[TOTAL_PINS];  // Pins in use, in pin order
+uint8_t numEnabledPins = 0;
+InputScanPin inputScanPins[TOTAL_PINS];  // Digital inputs to scan, in pin order
+uint8_t numInputScanPins = 0;
+const volatile PortMask* inputPortRegisters[MAX_GPIO_PORTS];  // Port input registers read once per scan
+uint8_t numInputPorts = 0;
 
 /*
-* Get the count of analogue and PWM capable pins
+* Point the input snapshots at their storage and map the analogue channels to their pins, the
+* pin counts and buffer sizes are all fixed at compile time
 */
 void setupPinDetails() {
+  for (uint8_t snapshot = 0; snapshot < 2; snapshot++) {
+    inputSnapshots[snapshot].states = snapshotStates[snapshot];
+    inputSnapshots[snapshot].changes = snapshotChanges[snapshot];
+  }
+  uint8_t analoguePin = 0;
   for (uint8_t pin = 0; pin < numPins; pin++) {
     if (bitRead(pinMap[pin].capability, ANALOGUE_INPUT)) {
-      numAnaloguePins++;
-    }
-    if (bitRead(pinMap[pin].capability, DIGITAL_INPUT) || bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
-      numDigitalPins++;
-    }
-    if (bitRead(pinMap[pin].capability, PWM_OUTPUT)) {
-      numPWMPins++;
+      exioPins.analogueIndex[pin] = analoguePin;
+      analoguePinMap[analoguePin] = pin;
+      analoguePin++;
     }
   }
-  analoguePinBytes = numAnaloguePins * 2;
-  digitalPinBytes = (numDigitalPins + 7) / 8;
-  digitalPinStates = (byte*) calloc(digitalPinBytes, 1);
-  analoguePinStates = (byte*) calloc(analoguePinBytes, 1);
-  analoguePinMap = (uint8_t*) calloc(numAnaloguePins, 1);
+}
+
+/*
+* Function to copy a pin's label out of flash, label must hold PIN_LABEL_SIZE bytes
+*/
+void getPinLabel(uint8_t pin, char* label) {
+  strncpy_P(label, pinNameMap[pin].pinLabel, PIN_LABEL_SIZE);
 }
 
 /*
 * Function to initialise all pins as input and initialise pin struct
 */
 void initialisePins() {
-  for (uint8_t pin = 0; pin < numPins; pin++) {
 #if defined(HAS_SERVO_LIB)
-    if (exioPins[pin].servoIndex != 255 && servoMap[exioPins[pin].servoIndex].attached()) {
-      servoMap[exioPins[pin].servoIndex].detach();
+  for (uint8_t servo = 0; servo < nextServoObject; servo++) {
+    if (servoMap[servo].attached()) {
+      servoMap[servo].detach();
     }
+  }
 #endif
+  numAnimatingServos = 0;
+  for (uint8_t pin = 0; pin < numPins; pin++) {
+    free(servoDataArray[pin]);
+    servoDataArray[pin] = NULL;
     if (bitRead(pinMap[pin].capability, DIGITAL_INPUT) || bitRead(pinMap[pin].capability, ANALOGUE_INPUT)) {
       pinMode(pinMap[pin].physicalPin, INPUT);
-      exioPins[pin].direction = 1;
+      pinBitWrite(exioPins.direction, pin, 1);
     } else {
-      exioPins[pin].direction = 0;
+      pinBitWrite(exioPins.direction, pin, 0);
     }
-    exioPins[pin].enable = 0;
-    exioPins[pin].mode = 0;
-    exioPins[pin].pullup = 0;
-    exioPins[pin].servoIndex = 255;
+    exioPins.mode[pin] = 0;
+    exioPins.servoIndex[pin] = 255;
+  }
+  for (uint8_t word = 0; word < PIN_WORDS; word++) {
+    exioPins.enable[word] = 0;
+    exioPins.pullup[word] = 0;
   }
   for (uint8_t dPinByte = 0; dPinByte < digitalPinBytes; dPinByte++) {
     digitalPinStates[dPinByte] = 0;
   }
-  for (uint8_t aPinByte = 0; aPinByte < analoguePinBytes; aPinByte++) {
-    analoguePinStates[aPinByte] = 0;
-  }
-  for (uint8_t pin = 0; pin < numPins; pin++) {
-    servoDataArray[pin] = NULL;
+  directCommitReady = false;
+  for (uint8_t pinByte = 0; pinByte < (numPins + 7) / 8; pinByte++) {
+    stagedSetMask[pinByte] = 0;
+    stagedClearMask[pinByte] = 0;
   }
+  digitalOutputsStaged = false;
+  numActiveAnaloguePins = 0;
+  noInterrupts();
+  inputEventHead = 0;
+  inputEventTail = 0;
+  inputEventsDropped = 0;
+  inputEventsDroppedAcked = 0;
+  stagedEventCount = 0;
+  stagedEventsDropped = 0;
+  interrupts();
+  setAnalogueEncoding(ANALOGUE_16BIT);
+  resyncDigital = true;   // First delta read after initialisation sends the full state
+  inputsChanged = true;
+  setAttention(false);
+  pinConfigChanged();
 #if defined(HAS_SERVO_LIB)
   nextServoObject = 0;
 #endif
@@ -91,96 +164,405 @@ void initialisePins() {
 */
 bool enableDigitalInput(uint8_t pin, bool pullup) {
   if (!bitRead(pinMap[pin].capability, DI)) {
-    USB_SERIAL.print(F("ERROR! pin "));
-    USB_SERIAL.print(pinMap[pin].physicalPin);
-    USB_SERIAL.println(F(" not capable of digital input"));
+    logEvent(LOG_NOT_DIGITAL_INPUT, pin);
     return false;
   }
-  if (exioPins[pin].enable && exioPins[pin].mode != MODE_DIGITAL && !exioPins[pin].direction) {
-    USB_SERIAL.print(F("ERROR! pin "));
-    USB_SERIAL.print(pinMap[pin].physicalPin);
-    USB_SERIAL.println(F(" already in use, cannot use as a digital input pin"));
+  uint8_t word = pinWord(pin);
+  PinWord bit = pinBit(pin);
+  if (exioPins.enable[word] & ~exioPins.direction[word] & bit) {   // Enabled as an output
+    logEvent(LOG_IN_USE_INPUT, pin);
     return false;
   }
-  if (!exioPins[pin].enable || (exioPins[pin].enable && exioPins[pin].direction == 1)) {
-    exioPins[pin].direction = 1;   // Must be an input if we got a pullup config
-    exioPins[pin].mode = MODE_DIGITAL;        // Must be digital if we got a pullup config
-    exioPins[pin].pullup = pullup;
-    exioPins[pin].enable = 1;
-    if (exioPins[pin].pullup) {
-      pinMode(pinMap[pin].physicalPin, INPUT_PULLUP);
-    } else {
-      pinMode(pinMap[pin].physicalPin, INPUT);
-    }
-    return true;
+  if (exioPins.mode[pin] == MODE_ANALOGUE) {
+    removeActiveAnaloguePin(pin);
+  }
+  exioPins.direction[word] |= bit;    // Must be an input if we got a pullup config
+  exioPins.mode[pin] = MODE_DIGITAL;  // Must be digital if we got a pullup config
+  pinBitWrite(exioPins.pullup, pin, pullup);
+  exioPins.enable[word] |= bit;
+  pinConfigChanged();
+  if (pullup) {
+    pinMode(pinMap[pin].physicalPin, INPUT_PULLUP);
   } else {
-    USB_SERIAL.print(F("ERROR! pin "));
-    USB_SERIAL.print(pinMap[pin].physicalPin);
-    USB_SERIAL.println(F(" already in use, cannot use as a digital input pin"));
-    return false;
+    pinMode(pinMap[pin].physicalPin, INPUT);
   }
+  return true;
 }
 
 /* 
 * Function to write to a digital output pint
 */
 bool writeDigitalOutput(uint8_t pin, bool state) {
-  uint8_t pinByte = pin / 8;
-  uint8_t pinBit = pin - pinByte * 8;
+  if (!enableDigitalOutput(pin)) {
+    return false;
+  }
+  setDigitalPinState(pin, state);
+  digitalWrite(pinMap[pin].physicalPin, state);
+  return true;
+}
+
+/*
+* Function to check a pin can be used as a digital output and configure it as one
+*/
+bool enableDigitalOutput(uint8_t pin) {
   if (bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
-    if (exioPins[pin].enable && (exioPins[pin].direction || exioPins[pin].mode != MODE_DIGITAL)) {
-      USB_SERIAL.print(F("ERROR! pin "));
-      USB_SERIAL.print(pinMap[pin].physicalPin);
-      USB_SERIAL.println(F(" already in use, cannot use as a digital output pin"));
+    uint8_t word = pinWord(pin);
+    PinWord enabled = exioPins.enable[word] & pinBit(pin);
+    if ((enabled & exioPins.direction[word]) || (enabled && exioPins.mode[pin] != MODE_DIGITAL)) {
+      logEvent(LOG_IN_USE_OUTPUT, pin);
       return false;
     }
-    if (!exioPins[pin].enable || (exioPins[pin].enable && exioPins[pin].direction == 0)) {
-      exioPins[pin].enable = 1;
-      exioPins[pin].mode = MODE_DIGITAL;
-      exioPins[pin].direction = 0;
+    if (!enabled) {
+      exioPins.enable[word] |= pinBit(pin);
+      exioPins.mode[pin] = MODE_DIGITAL;
+      exioPins.direction[word] &= ~pinBit(pin);
       pinMode(pinMap[pin].physicalPin, OUTPUT);
-      if (state) {
-        bitSet(digitalPinStates[pinByte], pinBit);
-      } else {
-        bitClear(digitalPinStates[pinByte], pinBit);
-      }
-      digitalWrite(pinMap[pin].physicalPin, state);
-      return true;
-    } else {
-      return false;
+      pinConfigChanged();
     }
+    return true;
   } else {
-    USB_SERIAL.print(F("ERROR! Pin "));
-    USB_SERIAL.print(pinMap[pin].physicalPin);
-    USB_SERIAL.println(F(" not capable of digital output"));
+    logEvent(LOG_NOT_DIGITAL_OUTPUT, pin);
     return false;
   }
 }
 
+/*
+* Function to hold digital output writes in the staged masks until commitDigitalOutputs()
+* Masks are as for writeDigitalOutputs(), a later write to the same pin replaces an earlier one
+* The commit is not prepared while the masks are changing, only once they are complete
+*/
+bool stageDigitalOutputs(uint8_t firstPin, uint8_t maskBytes, byte* setMask, byte* clearMask) {
+  bool response = true;
+  directCommitReady = false;
+  for (uint8_t maskByte = 0; maskByte < maskBytes; maskByte++) {
+    byte setBits = setMask[maskByte];
+    byte clearBits = clearMask[maskByte];
+    if (setBits & clearBits) {
+      response = false;   // Can't set and clear the same pin
+    }
+    byte changeBits = setBits ^ clearBits;
+    for (uint8_t maskBit = 0; changeBits != 0 && maskBit < 8; maskBit++) {
+      if (!bitRead(changeBits, maskBit)) continue;
+      uint16_t pin = firstPin + maskByte * 8 + maskBit;
+      if (pin >= numPins) {
+        response = false;
+        continue;
+      }
+      bool state = bitRead(setBits, maskBit);
+      bitWrite(stagedSetMask[pin / 8], pin % 8, state);
+      bitWrite(stagedClearMask[pin / 8], pin % 8, !state);
+      digitalOutputsStaged = true;
+    }
+  }
+  prepareDigitalCommit();
+  return response;
+}
+
+/*
+* Function to write all staged digital outputs, pins sharing a port are written in one access
+* so they change together, platforms without port access fall back to digitalWrite()
+*/
+bool commitDigitalOutputs() {
+  directCommitReady = false;
+  if (!digitalOutputsStaged) {
+    return true;
+  }
+  bool response = true;
+  numCommitPorts = 0;
+  for (uint8_t pin = 0; pin < numPins; pin++) {
+    bool set = bitRead(stagedSetMask[pin / 8], pin % 8);
+    bool clear = bitRead(stagedClearMask[pin / 8], pin % 8);
+    if (!set && !clear) continue;
+    if (!enableDigitalOutput(pin)) {
+      response = false;
+      continue;
+    }
+    setDigitalPinState(pin, set);
+    if (!addCommitPort(pin, set)) {
+      digitalWrite(pinMap[pin].physicalPin, set);
+    }
+  }
+  writeCommitPorts();
+  for (uint8_t pinByte = 0; pinByte < (numPins + 7) / 8; pinByte++) {
+    stagedSetMask[pinByte] = 0;
+    stagedClearMask[pinByte] = 0;
+  }
+  digitalOutputsStaged = false;
+  return response;
+}
+
+/*
+* Function to add a pin to the port writes of a commit, returns false if it has no port access
+* or there are no port slots left, so it must be written with digitalWrite()
+*/
+bool addCommitPort(uint8_t pin, bool set) {
+#if defined(USE_FAST_WRITES) || defined(ARDUINO_ARCH_STM32)
+  uint8_t physicalPin = pinMap[pin].physicalPin;
+#if defined(USE_FAST_WRITES)
+  volatile uint8_t* portRegister = portOutputRegister(digitalPinToPort(physicalPin));
+#else
+  GPIO_TypeDef* portRegister = digitalPinToPort(physicalPin);
+#endif
+  uint8_t port = 0;
+  while (port < numCommitPorts && commitPortRegisters[port] != portRegister) port++;
+  if (port == numCommitPorts) {
+    if (numCommitPorts == MAX_GPIO_PORTS) return false;   // Shouldn't happen on supported boards
+    commitPortRegisters[port] = portRegister;
+    commitPortSet[port] = 0;
+    commitPortClear[port] = 0;
+    numCommitPorts++;
+  }
+  if (set) {
+    commitPortSet[port] |= digitalPinToBitMask(physicalPin);
+  } else {
+    commitPortClear[port] |= digitalPinToBitMask(physicalPin);
+  }
+  return true;
+#else
+  (void)pin;
+  (void)set;
+  return false;
+#endif
+}
+
+/*
+* Function to write the commit port writes, one access per port
+*/
+void writeCommitPorts() {
+#if defined(USE_FAST_WRITES)
+  uint8_t oldSREG = SREG;   // May be called from an interrupt, so restore rather than enable
+  noInterrupts();
+  for (uint8_t port = 0; port < numCommitPorts; port++) {
+    *commitPortRegisters[port] = (*commitPortRegisters[port] & ~commitPortClear[port]) | commitPortSet[port];
+  }
+  SREG = oldSREG;
+#elif defined(ARDUINO_ARCH_STM32)
+  for (uint8_t port = 0; port < numCommitPorts; port++) {
+    commitPortRegisters[port]->BSRR = commitPortSet[port] | (commitPortClear[port] << 16);
+  }
+#endif
+}
+
+/*
+* Function to build the port writes for the staged digital outputs once they've been staged, so
+* EXIOCOMMIT can write them straight from the interrupt it's received in. This is only possible
+* when every staged pin is already a digital output and has port access, otherwise the commit
+* waits for commitDigitalOutputs() in loop().
+*/
+void prepareDigitalCommit() {
+  directCommitReady = false;
+  if (!digitalOutputsStaged) return;
+  numCommitPorts = 0;
+  for (uint8_t pin = 0; pin < numPins; pin++) {
+    bool set = bitRead(stagedSetMask[pin / 8], pin % 8);
+    bool clear = bitRead(stagedClearMask[pin / 8], pin % 8);
+    if (!set && !clear) continue;
+    uint8_t word = pinWord(pin);
+    if (!(exioPins.enable[word] & pinBit(pin)) || (exioPins.direction[word] & pinBit(pin)) ||
+        exioPins.mode[pin] != MODE_DIGITAL) return;
+    if (!addCommitPort(pin, set)) return;
+  }
+  directCommitReady = true;
+}
+
+/*
+* Function called when EXIOCOMMIT is received to write the prepared digital outputs at once,
+* returns false if they weren't prepared. The queued EXIOCOMMIT still runs from loop() to
+* update the pin states and apply held EXIOWRAN frames, rewriting the same port values.
+*/
+bool commitPreparedOutputs() {
+  if (!directCommitReady) return false;
+  writeCommitPorts();
+  directCommitReady = false;
+  return true;
+}
+
+/*
+* Function to write multiple digital outputs in one pass, starting at firstPin
+* Pins with their bit set in setMask are set high, in clearMask are set low, neither are untouched
+*/
+bool writeDigitalOutputs(uint8_t firstPin, uint8_t maskBytes, byte* setMask, byte* clearMask) {
+  bool response = true;
+  for (uint8_t maskByte = 0; maskByte < maskBytes; maskByte++) {
+    byte setBits = setMask[maskByte];
+    byte clearBits = clearMask[maskByte];
+    if (setBits & clearBits) {
+      response = false;   // Can't set and clear the same pin
+    }
+    byte changeBits = setBits ^ clearBits;
+    if (changeBits == 0) continue;
+    for (uint8_t maskBit = 0; maskBit < 8; maskBit++) {
+      if (!bitRead(changeBits, maskBit)) continue;
+      uint16_t pin = firstPin + maskByte * 8 + maskBit;
+      if (pin >= numPins || !writeDigitalOutput(pin, bitRead(setBits, maskBit))) {
+        response = false;
+      }
+    }
+  }
+  return response;
+}
+
 /*
 * Function to enable pins as analogue input pins to start reading
 */
 bool enableAnalogue(uint8_t pin) {
   if (bitRead(pinMap[pin].capability, ANALOGUE_INPUT)) {
-    if (exioPins[pin].enable && exioPins[pin].mode != MODE_ANALOGUE && !exioPins[pin].direction) {
-      USB_SERIAL.print(F("ERROR! pin "));
-      USB_SERIAL.print(pinMap[pin].physicalPin);
-      USB_SERIAL.println(F(" already in use, cannot use as an analogue input pin"));
+    uint8_t word = pinWord(pin);
+    if ((exioPins.enable[word] & ~exioPins.direction[word] & pinBit(pin)) && exioPins.mode[pin] != MODE_ANALOGUE) {
+      logEvent(LOG_IN_USE_ANALOGUE, pin);
       return false;
     }
-    exioPins[pin].enable = 1;
-    exioPins[pin].mode = MODE_ANALOGUE;
-    exioPins[pin].direction = 1;
+    if (exioPins.mode[pin] != MODE_ANALOGUE) {
+      activeAnaloguePins[numActiveAnaloguePins++] = pin;
+    }
+    exioPins.enable[word] |= pinBit(pin);
+    exioPins.mode[pin] = MODE_ANALOGUE;
+    exioPins.direction[word] |= pinBit(pin);
     pinMode(pinMap[pin].physicalPin, INPUT);
+    pinConfigChanged();
     return true;
   } else {
-    USB_SERIAL.print(F("ERROR! Pin "));
-    USB_SERIAL.print(pinMap[pin].physicalPin);
-    USB_SERIAL.println(F(" not capable of analogue input"));
+    logEvent(LOG_NOT_ANALOGUE, pin);
     return false;
   }
 }
 
+/*
+* Function to remove a pin from the list of analogue inputs being sampled
+*/
+void removeActiveAnaloguePin(uint8_t pin) {
+  for (uint8_t active = 0; active < numActiveAnaloguePins; active++) {
+    if (activeAnaloguePins[active] == pin) {
+      activeAnaloguePins[active] = activeAnaloguePins[--numActiveAnaloguePins];
+      return;
+    }
+  }
+}
+
+/*
+* Function to apply packed input configuration to count pins starting at firstPin
+* Each byte holds 4 pins at 2 bits per pin, lowest pin in the least significant bits
+*/
+bool configureInputs(uint8_t firstPin, uint8_t count, byte* config) {
+  bool response = true;
+  for (uint8_t offset = 0; offset < count; offset++) {
+    uint16_t pin = firstPin + offset;
+    uint8_t pinSetting = (config[offset / 4] >> ((offset % 4) * 2)) & 0x03;
+    if (pinSetting == CFG_NO_CHANGE) continue;
+    if (pin >= numPins) {
+      response = false;
+      break;
+    }
+    switch(pinSetting) {
+      case CFG_DIGITAL:
+        if (!enableDigitalInput(pin, false)) response = false;
+        break;
+      case CFG_DIGITAL_PULLUP:
+        if (!enableDigitalInput(pin, true)) response = false;
+        break;
+      case CFG_ANALOGUE:
+        if (!enableAnalogue(pin)) response = false;
+        break;
+      default:
+        break;
+    }
+  }
+  return response;
+}
+
+/*
+* Function to change the analogue encoding, clearing all analogue states as the layout changes
+*/
+bool setAnalogueEncoding(uint8_t encoding) {
+  if (encoding > ANALOGUE_PACKED10) return false;
+  analoguePinBytes = analogueEncodedBytes(encoding, numAnaloguePins);
+  analogueEncoding = encoding;
+  for (uint8_t aPinByte = 0; aPinByte < ANALOGUE_PIN_BYTES; aPinByte++) {
+    analoguePinStates[aPinByte] = 0;
+  }
+  inputsChanged = true;
+  return true;
+}
+
+/*
+* Function to store an analogue reading in analoguePinStates using the current encoding
+* Returns true if the stored value changed
+*/
+bool storeAnalogue(uint8_t channel, uint16_t value) {
+  if (analogueEncoding == ANALOGUE_8BIT) {
+    value >>= (ANALOGUE_READ_BITS - 8);
+  } else if (analogueEncoding == ANALOGUE_PACKED10) {
+    value >>= (ANALOGUE_READ_BITS - 10);
+  }
+  if (decodeAnalogue(analoguePinStates, analogueEncoding, channel) == value) return false;
+  encodeAnalogue(analoguePinStates, analogueEncoding, channel, value);
+  return true;
+}
+
+/*
+* Function to read an analogue value back out of analoguePinStates using the current encoding
+*/
+uint16_t readAnalogueState(uint8_t channel) {
+  return decodeAnalogue(analoguePinStates, analogueEncoding, channel);
+}
+
+/*
+* Functions to write and read an already scaled value for a channel in a block of analogue states
+* Packed 10 bit uses 5 bytes for each group of 4 channels, the 4 low bytes then the high 2 bits,
+* a partial last group is padded to 5 bytes so its high bits are always in the group's last byte
+*/
+void encodeAnalogue(byte* states, uint8_t encoding, uint8_t channel, uint16_t value) {
+  switch(encoding) {
+    case ANALOGUE_16BIT:
+      states[channel * 2] = value & 0xFF;
+      states[channel * 2 + 1] = value >> 8;
+      break;
+    case ANALOGUE_8BIT:
+      states[channel] = value;
+      break;
+    case ANALOGUE_PACKED10: {
+      uint8_t highByte = (channel / 4) * 5 + 4;
+      uint8_t highShift = (channel % 4) * 2;
+      states[(channel / 4) * 5 + channel % 4] = value & 0xFF;
+      states[highByte] = (states[highByte] & ~(0x03 << highShift)) | (((value >> 8) & 0x03) << highShift);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+uint16_t decodeAnalogue(const byte* states, uint8_t encoding, uint8_t channel) {
+  switch(encoding) {
+    case ANALOGUE_16BIT:
+      return (states[channel * 2 + 1] << 8) + states[channel * 2];
+    case ANALOGUE_8BIT:
+      return states[channel];
+    case ANALOGUE_PACKED10: {
+      uint8_t highBits = (states[(channel / 4) * 5 + 4] >> ((channel % 4) * 2)) & 0x03;
+      return (highBits << 8) + states[(channel / 4) * 5 + channel % 4];
+    }
+    default:
+      return 0;
+  }
+}
+
+/*
+* Function to return the number of bytes needed for a number of channels in an encoding
+*/
+uint8_t analogueEncodedBytes(uint8_t encoding, uint8_t channels) {
+  switch(encoding) {
+    case ANALOGUE_16BIT:
+      return channels * 2;
+    case ANALOGUE_8BIT:
+      return channels;
+    case ANALOGUE_PACKED10:
+      return (channels + 3) / 4 * 5;
+    default:
+      return 0;
+  }
+}
+
 /*
 * Function to write PWM output to a pin
 */
@@ -192,29 +574,28 @@ bool writeAnalogue(uint8_t pin, uint16_t value, uint8_t profile, uint16_t durati
   bool useSuperPin = bitRead(profile, 7); // if bit 7 is set, we're using FADE, therefore use SuperPin
   if (((useServoLib || useSuperPin) && bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) ||
       bitRead(pinMap[pin].capability, PWM_OUTPUT)) {
-    if (exioPins[pin].enable && (exioPins[pin].direction ||
-        (exioPins[pin].mode != MODE_PWM && exioPins[pin].mode != MODE_PWM_LED))) {
-      USB_SERIAL.print(F("ERROR! pin "));
-      USB_SERIAL.print(pinMap[pin].physicalPin);
-      USB_SERIAL.println(F(" already in use, cannot use as a PWM output pin"));
+    uint8_t word = pinWord(pin);
+    PinWord enabled = exioPins.enable[word] & pinBit(pin);
+    if ((enabled & exioPins.direction[word]) ||
+        (enabled && exioPins.mode[pin] != MODE_PWM && exioPins.mode[pin] != MODE_PWM_LED)) {
+      logEvent(LOG_IN_USE_PWM, pin);
       return false;
     } else {
       if (useServoLib || useSuperPin) {
         if (!configureServo(pin, useSuperPin)) return false;
       }
-      if (!exioPins[pin].enable) {
-        exioPins[pin].enable = 1;
+      if (!enabled) {
+        exioPins.enable[word] |= pinBit(pin);
         if (useSuperPin) {
-          exioPins[pin].mode = MODE_PWM_LED;
+          exioPins.mode[pin] = MODE_PWM_LED;
         } else {
-          exioPins[pin].mode = MODE_PWM;
+          exioPins.mode[pin] = MODE_PWM;
         }
-        exioPins[pin].direction = 0;
+        exioPins.direction[word] &= ~pinBit(pin);
+        pinConfigChanged();
       }
 
-      uint8_t pinByte = pin / 8;
-      uint8_t pinBit = pin - pinByte * 8;
-      bitSet(digitalPinStates[pinByte], pinBit);
+      setDigitalPinState(pin, true);
 
       if (value > 4095) value = 4095;
       else if (value < 0) value = 0;
@@ -241,52 +622,253 @@ bool writeAnalogue(uint8_t pin, uint16_t value, uint8_t profile, uint16_t durati
       s->stepNumber = 0;
       s->toPosition = value;
       s->fromPosition = s->currentPosition;
+      startServoAnimation(pin);
       return true;
     }
   } else {
-    USB_SERIAL.print(F("ERROR! Pin "));
-    USB_SERIAL.print(pinNameMap[pin].pinLabel);
-    USB_SERIAL.println(F(" not capable of PWM output"));
+    logEvent(LOG_NOT_PWM, pin);
     return false;
   }
 }
 
+/*
+* Function to update a pin's bit in digitalPinStates, returns true if the state changed
+*/
+bool setDigitalPinState(uint8_t pin, bool state) {
+  uint8_t pinByte = pin / 8;
+  uint8_t pinBit = pin - pinByte * 8;
+  if (bitRead(digitalPinStates[pinByte], pinBit) == state) return false;
+  if (state) {
+    bitSet(digitalPinStates[pinByte], pinBit);
+  } else {
+    bitClear(digitalPinStates[pinByte], pinBit);
+  }
+  inputsChanged = true;
+  return true;
+}
+
+/*
+* Function to publish the current input states for requestEvent() to send
+* The back snapshot is filled then made the front one with a single byte write, so a
+* response is never built from a partially updated snapshot
+*/
+void publishInputs() {
+  uint8_t backSnapshot = frontSnapshot ^ 1;
+  if (streamingSnapshot == backSnapshot) {
+    return;   // Still being sent from a publish ago, try again next loop
+  }
+  InputSnapshot* snapshot = &inputSnapshots[backSnapshot];
+  for (uint8_t dPinByte = 0; dPinByte < digitalPinBytes; dPinByte++) {
+    snapshot->states[dPinByte] = digitalPinStates[dPinByte];
+  }
+  for (uint8_t aPinByte = 0; aPinByte < analoguePinBytes; aPinByte++) {
+    snapshot->states[digitalPinBytes + aPinByte] = analoguePinStates[aPinByte];
+  }
+  snapshot->inputBytes[0] = digitalPinBytes;
+  snapshot->inputBytes[1] = analoguePinBytes;
+  snapshot->analogueEncoding = analogueEncoding;
+  if (inputsChanged) {
+    inputsChanged = false;
+    inputGeneration++;    // Once per published change, however many inputs changed
+  }
+  snapshot->generation[0] = inputGeneration & 0xFF;
+  snapshot->generation[1] = inputGeneration >> 8;
+  // An EXIORDDC read while the delta is built changes what the CommandStation holds, so the
+  // delta is only published if none was sent since it was built, otherwise it is built again
+  bool published = false;
+  while (!published) {
+    rebaseDelta();
+    buildDelta(snapshot);
+    noInterrupts();
+    if (!deltaSent) {
+      frontSnapshot = backSnapshot;
+      published = true;
+    }
+    interrupts();
+  }
+  updateAttention();    // Only after the swap, so every read from here on sees the change
+}
+
+/*
+* Function to record the digital states the CommandStation now holds after an EXIORDDC read
+*/
+void rebaseDelta() {
+  noInterrupts();
+  bool sent = deltaSent;
+  uint8_t sentSnapshot = deltaSentSnapshot;
+  deltaSent = false;
+  interrupts();
+  if (!sent) return;
+  for (uint8_t dPinByte = 0; dPinByte < digitalPinBytes; dPinByte++) {
+    sentDigitalStates[dPinByte] = inputSnapshots[sentSnapshot].states[dPinByte];
+  }
+  if (inputSnapshots[sentSnapshot].fullDelta) {
+    resyncDigital = false;
+  }
+}
+
+/*
+* Function to build a snapshot's EXIORDDC delta against the states last sent
+*/
+void buildDelta(InputSnapshot* snapshot) {
+  uint8_t deltaBytes = digitalChangeBytes;
+  for (uint8_t cByte = 0; cByte < digitalChangeBytes; cByte++) {
+    snapshot->changes[cByte] = 0;
+  }
+  for (uint8_t dPinByte = 0; dPinByte < digitalPinBytes; dPinByte++) {
+    if (resyncDigital || snapshot->states[dPinByte] != sentDigitalStates[dPinByte]) {
+      bitSet(snapshot->changes[dPinByte / 8], dPinByte % 8);
+      snapshot->changes[deltaBytes++] = snapshot->states[dPinByte];
+    }
+  }
+  snapshot->changeBytes = deltaBytes;
+  snapshot->fullDelta = resyncDigital;
+}
+
+/*
+* Functions to drive the optional attention pin, which is open drain so multiple devices
+* can share the one CommandStation input: active pulls the line low, inactive releases it
+* The pin is only changed from loop(), transports call releaseAttention() from interrupts
+*/
+void setupAttentionPin() {
+#if defined(ATTENTION_PIN)
+  digitalWrite(ATTENTION_PIN, LOW);
+  pinMode(ATTENTION_PIN, INPUT);
+  USB_SERIAL.print(F("Attention output enabled on pin "));
+  USB_SERIAL.println(ATTENTION_PIN);
+#endif
+}
+
+void setAttention(bool active) {
+#if defined(ATTENTION_PIN)
+  if (active == attentionActive) return;
+  attentionActive = active;
+  if (active) {
+    pinMode(ATTENTION_PIN, OUTPUT);
+    digitalWrite(ATTENTION_PIN, LOW);
+  } else {
+    pinMode(ATTENTION_PIN, INPUT);
+  }
+#else
+  (void)active;
+#endif
+}
+
+/*
+* Function for the transports to flag the CommandStation has read the inputs, the attention pin
+* is released by the next updateAttention()
+*/
+void releaseAttention() {
+  attentionReleased = true;
+}
+
+/*
+* Function to release the attention pin once the inputs have been read, then assert it for any
+* digital input change just published. A read between the swap and this only causes an extra
+* read, never a missed change.
+*/
+void updateAttention() {
+  if (attentionReleased) {
+    attentionReleased = false;
+    setAttention(false);
+  }
+  if (attentionPending) {
+    attentionPending = false;
+    setAttention(true);
+  }
+}
+
+/*
+* Function to record a digital input change, dropping and counting it if the queue is full
+*/
+void queueInputEvent(uint8_t pin, bool state, uint32_t timestamp) {
+  uint8_t head = inputEventHead;
+  uint8_t next = (head + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+  if (next == inputEventTail) {
+    if ((uint8_t)(inputEventsDropped - inputEventsDroppedAcked) < 255) inputEventsDropped++;
+    return;
+  }
+  inputEvents[head].pinState = (pin & 0x7F) | (state << 7);
+  inputEvents[head].timestamp = timestamp;
+  inputEventHead = next;
+}
+
 void processInputs() {
-  for (uint8_t pin = 0; pin < numPins; pin++) {
-    uint8_t pinByte = pin / 8;
-    uint8_t pinBit = pin - pinByte * 8;
-    if (exioPins[pin].enable && exioPins[pin].direction) {
-      switch(exioPins[pin].mode) {
-        case MODE_DIGITAL: {
-          bool pullup = exioPins[pin].pullup;
-          if (pullup) {
-            pinMode(pinMap[pin].physicalPin, INPUT_PULLUP);
-          } else {
-            pinMode(pinMap[pin].physicalPin, INPUT);
-          }
-          bool currentState = digitalRead(pinMap[pin].physicalPin);
-          if (pullup) currentState = !currentState;
-          if (currentState) {
-            bitSet(digitalPinStates[pinByte], pinBit);
-          } else {
-            bitClear(digitalPinStates[pinByte], pinBit);
-          }
-          break;
-        }
-        case MODE_ANALOGUE: {
-          uint8_t pinLSBByte = exioPins[pin].analogueLSBByte;
-          uint8_t pinMSBByte = pinLSBByte + 1;
-          pinMode(pinMap[pin].physicalPin, INPUT);
-          uint16_t value = analogRead(pinMap[pin].physicalPin);
-          analoguePinStates[pinLSBByte] = value & 0xFF;
-          analoguePinStates[pinMSBByte] = value >> 8;
-          break;
-        }
-        default:
-          break;
+  uint32_t scanTime = micros();
+  if (scanEpoch != configEpoch) {
+    buildPinLists();   // Pin modes are only applied here, the scan itself only reads
+  }
+  // Read every port with an input once, then pick each input's bit out of its port
+  PortMask portValues[MAX_GPIO_PORTS];
+  for (uint8_t port = 0; port < numInputPorts; port++) {
+    portValues[port] = *inputPortRegisters[port];
+  }
+  for (uint8_t scanPin = 0; scanPin < numInputScanPins; scanPin++) {
+    InputScanPin* input = &inputScanPins[scanPin];
+    bool currentState = (portValues[input->port] & input->mask) != 0;
+    if (pinBitRead(exioPins.pullup, input->pin)) currentState = !currentState;
+    if (setDigitalPinState(input->pin, currentState)) {
+      queueInputEvent(input->pin, currentState, scanTime);
+      attentionPending = true;
+    }
+  }
+  // Only sample enabled analogue inputs
+  for (uint8_t active = 0; active < numActiveAnaloguePins; active++) {
+    uint8_t pin = activeAnaloguePins[active];
+    uint16_t value = analogRead(pinMap[pin].physicalPin);
+    if (storeAnalogue(exioPins.analogueIndex[pin], value)) {
+      inputsChanged = true;
+    }
+  }
+}
+
+/*
+* Function to flag that pin configuration has changed, so anything precomputed from it is rebuilt
+*/
+void pinConfigChanged() {
+  configEpoch++;
+  directCommitReady = false;
+}
+
+/*
+* Function to apply the mode of every input pin and build the list of pins in use, and the list
+* of digital inputs and port input registers they're read from, called once after each
+* configuration change so per loop work is proportional to the pins in use
+*/
+void buildPinLists() {
+  numEnabledPins = 0;
+  numInputScanPins = 0;
+  numInputPorts = 0;
+  for (uint8_t active = 0; active < numActiveAnaloguePins; active++) {
+    pinMode(pinMap[activeAnaloguePins[active]].physicalPin, INPUT);
+  }
+  for (uint8_t word = 0; word < PIN_WORDS; word++) {
+    PinWord enabled = exioPins.enable[word];
+    PinWord inputs = enabled & exioPins.direction[word];  // Every enabled input in this word
+    for (uint8_t pin = word * PIN_WORD_BITS; enabled; pin++, enabled >>= 1, inputs >>= 1) {
+      if (!(enabled & 1)) continue;
+      enabledPins[numEnabledPins++] = pin;
+      if (!(inputs & 1) || exioPins.mode[pin] != MODE_DIGITAL) continue;
+      uint8_t physicalPin = pinMap[pin].physicalPin;
+      if (pinBitRead(exioPins.pullup, pin)) {
+        pinMode(physicalPin, INPUT_PULLUP);
+      } else {
+        pinMode(physicalPin, INPUT);
+      }
+      const volatile PortMask* portRegister = portInputRegister(digitalPinToPort(physicalPin));
+      uint8_t port = 0;
+      while (port < numInputPorts && inputPortRegisters[port] != portRegister) port++;
+      if (port == numInputPorts) {
+        if (numInputPorts == MAX_GPIO_PORTS) continue;  // Shouldn't happen on supported boards
+        inputPortRegisters[numInputPorts++] = portRegister;
       }
+      inputScanPins[numInputScanPins].pin = pin;
+      inputScanPins[numInputScanPins].port = port;
+      inputScanPins[numInputScanPins].mask = digitalPinToBitMask(physicalPin);
+      numInputScanPins++;
     }
   }
+  scanEpoch = configEpoch;
 }
 
 bool processOutputTest(bool testState) {
@@ -295,16 +877,10 @@ bool processOutputTest(bool testState) {
       testState = !testState;
       lastOutputTest = millis();
       for (uint8_t pin = 0; pin < numPins; pin++) {
-        uint8_t pinByte = pin / 8;
-        uint8_t pinBit = pin - pinByte * 8;
         if (bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
           pinMode(pinMap[pin].physicalPin, OUTPUT);
           digitalWrite(pinMap[pin].physicalPin, testState);
-          if (testState) {
-            bitSet(digitalPinStates[pinByte], pinBit);
-          } else {
-            bitClear(digitalPinStates[pinByte], pinBit);
-          }
+          setDigitalPinState(pin, testState);
         }
       }
     }
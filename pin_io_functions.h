@@ -24,12 +24,44 @@
 #include "globals.h"
 
 void setupPinDetails();
+void getPinLabel(uint8_t pin, char* label);
 void initialisePins();
 bool enableDigitalInput(uint8_t pin, bool pullup);
 bool writeDigitalOutput(uint8_t pin, bool state);
+bool writeDigitalOutputs(uint8_t firstPin, uint8_t maskBytes, byte* setMask, byte* clearMask);
+bool enableDigitalOutput(uint8_t pin);
+bool stageDigitalOutputs(uint8_t firstPin, uint8_t maskBytes, byte* setMask, byte* clearMask);
+bool commitDigitalOutputs();
+bool addCommitPort(uint8_t pin, bool set);
+void writeCommitPorts();
+void prepareDigitalCommit();
+bool commitPreparedOutputs();
 bool enableAnalogue(uint8_t pin);
+bool configureInputs(uint8_t firstPin, uint8_t count, byte* config);
+bool setAnalogueEncoding(uint8_t encoding);
+void removeActiveAnaloguePin(uint8_t pin);
+bool storeAnalogue(uint8_t channel, uint16_t value);
+uint16_t readAnalogueState(uint8_t channel);
+void encodeAnalogue(byte* states, uint8_t encoding, uint8_t channel, uint16_t value);
+uint16_t decodeAnalogue(const byte* states, uint8_t encoding, uint8_t channel);
+uint8_t analogueEncodedBytes(uint8_t encoding, uint8_t channels);
 bool writeAnalogue(uint8_t pin, uint16_t value, uint8_t profile=0, uint16_t duration=0);
+bool setDigitalPinState(uint8_t pin, bool state);
+void publishInputs();
+void rebaseDelta();
+void buildDelta(InputSnapshot* snapshot);
+void setupAttentionPin();
+void setAttention(bool active);
+void releaseAttention();
+void updateAttention();
+void queueInputEvent(uint8_t pin, bool state, uint32_t timestamp);
 void processInputs();
+void pinConfigChanged();
+extern uint8_t configEpoch;
+extern uint8_t scanEpoch;
+extern uint8_t enabledPins[TOTAL_PINS];
+extern uint8_t numEnabledPins;
+void buildPinLists();
 bool processOutputTest(bool testState);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,541 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+* The EXIO protocol core shared by every transport. A transport passes each complete frame it
+* receives to processFrame(), and calls writeResponse() with its own writer when the
+* CommandStation reads, as receiveEvent() and requestEvent() do for I2C.
+*/
+
+#include <Arduino.h>
+#include "globals.h"
+#include "protocol_functions.h"
+#include "display_functions.h"
+#include "pin_io_functions.h"
+#include "command_functions.h"
+#include "log_functions.h"
+
+const uint8_t numAnaloguePins = TOTAL_ANALOGUE_PINS;
+const uint8_t numDigitalPins = TOTAL_DIGITAL_PINS;
+const uint8_t numPWMPins = TOTAL_PWM_PINS;  // Number of PWM capable pins
+bool setupComplete = false;   // Flag when initial configuration/setup has been received
+uint8_t outboundFlag;   // Used to determine what data to send back to the CommandStation
+byte commandBuffer[3];    // Command buffer to interact with device driver
+byte responseBuffer[1];   // Buffer to send single response back to device driver
+byte batchResponseBuffer[1 + MAX_BATCH_COMMANDS / 8];   // Overall status then a failed bit per batch sub-command
+uint8_t batchResponseBytes = 1;
+uint8_t numReceivedPins = 0;
+uint16_t lastSeenGeneration = 0;  // Input generation last seen by the CommandStation
+byte generationStatus;    // First byte of the EXIORDG response
+const byte errorResponse[1] = {EXIOERR};  // Sent when the inputs are too big for one response
+byte eventBuffer[1 + MAX_EVENTS_PER_READ * 5];  // Staged EXIORDEV response, event count then events
+byte analogueSelectBuffer[ANALOGUE_PIN_BYTES];  // Staged EXIORDANM response, sized for every channel at 16 bit
+byte registerBuffer[REGISTER_READ_BYTES];  // EXIOREG response, kept until it has been sent
+byte logBuffer[1 + MAX_LOG_PER_READ * 4];  // Staged EXIORDLOG response, entry count then entries
+byte capabilityBuffer[CAPS_BYTES];   // Capability descriptor sent by EXIOCAPS, built once at startup
+uint8_t capabilityOffset = 0;   // First descriptor byte sent by the next EXIOCAPS read
+const byte* stagedResponse = NULL;  // Response for writeResponse() to send when not sending inputs
+uint8_t stagedResponseBytes = 0;
+
+/*
+* Function to act on a complete frame received from the CommandStation by any transport.
+* Commands that change pins are validated and queued for loop() to execute, so the response
+* only reflects whether the command was valid and accepted.
+*/
+void processFrame(byte* buffer, uint8_t numBytes) {
+  if (numBytes == 0) {
+    return;
+  }
+  switch(buffer[0]) {
+    // Initial configuration start, must be 2 bytes
+    case EXIOINIT:
+      if (numBytes == 4 && queueCommand(buffer, numBytes)) {
+        numReceivedPins = buffer[1];
+        firstVpin = (buffer[3] << 8) + buffer[2];
+        if (numReceivedPins == numPins) {
+          displayEventFlag = 0;
+          setupComplete = true;
+        } else {
+          displayEventFlag = 1;
+          setupComplete = false;
+        }
+        outboundFlag = EXIOINIT;
+        displayEvent = EXIOINIT;
+      } else {
+        displayEventFlag = 2;
+      }
+      break;
+    case EXIOINITA:
+      if (numBytes == 1) {
+        outboundFlag = EXIOINITA;
+      } else {
+        displayEvent = EXIOINITA;
+      }
+      break;
+    // Flag to set digital pin pullups, 0 disabled, 1 enabled
+    case EXIODPUP:
+    case EXIOWRD:
+    case EXIOENAN:
+    case EXIOWRAN:
+    // Bulk digital write: first pin, mask byte count, set mask bytes, clear mask bytes
+    case EXIOWRDM:
+    // Packed input configuration: first pin, pin count, 2 bits per pin
+    case EXIOCFG:
+    // Analogue encoding for EXIORDAN and other analogue reads
+    case EXIOANENC:
+    // Latch mode on or off, and apply held outputs
+    case EXIOLATCH:
+    case EXIOCOMMIT:
+      outboundFlag = buffer[0];
+      if (validateCommand(buffer, numBytes)) {
+        bool staged = commandQueueEmpty();   // Every held write before this has been staged
+        bool response = queueCommand(buffer, numBytes);
+        if (response && buffer[0] == EXIOCOMMIT && staged) {
+          commitPreparedOutputs();   // Digital outputs change now, not at the next loop()
+        }
+        if (response) {
+          responseBuffer[0] = EXIORDY;
+        } else {
+          responseBuffer[0] = EXIOERR;
+        }
+      } else {
+        displayEvent = buffer[0];
+        responseBuffer[0] = EXIOERR;
+      }
+      break;
+    // Batch of sub-commands, each framed exactly as it would be sent on its own
+    // Valid sub-commands are run even if others fail, the status bitmap shows which didn't run
+    case EXIOBATCH:
+      outboundFlag = EXIOBATCH;
+      if (numBytes > 1) {
+        uint8_t numCommands = 0;
+        uint8_t numValid = validateBatch(&buffer[1], numBytes - 1, &batchResponseBuffer[1], &numCommands);
+        if (numValid > 0 && !queueCommand(buffer, numBytes)) {
+          failBatch(&batchResponseBuffer[1], numCommands);   // No room, nothing will run
+          numValid = 0;
+        }
+        if (numValid > 0 && numValid == numCommands) {
+          batchResponseBuffer[0] = EXIORDY;
+        } else {
+          displayEvent = EXIOBATCH;
+          batchResponseBuffer[0] = EXIOERR;
+        }
+        batchResponseBytes = 1 + (numCommands + 7) / 8;
+      } else {
+        displayEvent = EXIOBATCH;
+        batchResponseBuffer[0] = EXIOERR;
+        batchResponseBytes = 1;
+      }
+      break;
+    case EXIORDAN:
+      if (numBytes == 1) {
+        outboundFlag = EXIORDAN;
+      }
+      break;
+    // Analogue read of selected channels: channel bitmask, least significant bit first
+    case EXIORDANM:
+      if (numBytes > 1) {
+        stageSelectedAnalogue(&buffer[1], numBytes - 1);
+        outboundFlag = EXIORDANM;
+      }
+      break;
+    // Set the register pointer for register map reads
+    case EXIOREG:
+      if (numBytes == 2) {
+        stageRegisters(buffer[1]);
+        outboundFlag = EXIOREG;
+      }
+      break;
+    // Read up to the requested number of digital input change events, the second byte echoes
+    // the first byte of the previous EXIORDEV response, or is 0 if that read failed
+    case EXIORDEV:
+      if (numBytes == 3) {
+        acknowledgeInputEvents(buffer[2]);
+        stageInputEvents(buffer[1]);
+        outboundFlag = EXIORDEV;
+      }
+      break;
+    case EXIORDD:
+      if (numBytes == 1) {
+        outboundFlag = EXIORDD;
+      }
+      break;
+    case EXIORDDC:
+      if (numBytes == 1) {
+        outboundFlag = EXIORDDC;
+      }
+      break;
+    // Generation last seen, LSB first
+    case EXIORDG:
+      if (numBytes == 3) {
+        lastSeenGeneration = (buffer[2] << 8) + buffer[1];
+        outboundFlag = EXIORDG;
+      }
+      break;
+    case EXIORDALL:
+      if (numBytes == 1) {
+        outboundFlag = EXIORDALL;
+      }
+      break;
+    case EXIOVER:
+      if (numBytes == 1) {
+        outboundFlag = EXIOVER;
+      }
+      break;
+    // Read up to the requested number of error/event log entries
+    case EXIORDLOG:
+      if (numBytes == 2) {
+        stageLogEntries(buffer[1]);
+        outboundFlag = EXIORDLOG;
+      }
+      break;
+    // Capability descriptor, starting at the given offset for transports with small buffers
+    case EXIOCAPS:
+      if (numBytes == 2) {
+        capabilityOffset = buffer[1] < CAPS_BYTES ? buffer[1] : CAPS_BYTES;
+        outboundFlag = EXIOCAPS;
+      }
+      break;
+    default:
+      break;
+  }
+  stageResponse();
+}
+
+/*
+* Function to send the response to the last frame through the transport's writer.
+* Writers may send the data in place after this returns, so it must stay valid until then.
+* Inputs are sent from the front published snapshot, all other responses are staged by
+* processFrame(), so there is no response building here.
+*/
+void writeResponse(ResponseWriter write) {
+  InputSnapshot* snapshot = &inputSnapshots[frontSnapshot];
+  switch(outboundFlag) {
+    case EXIORDAN:
+      write(snapshot->states + digitalPinBytes, snapshot->inputBytes[1]);
+      break;
+    case EXIORDD:
+      releaseAttention();    // CommandStation is reading inputs, release attention
+      write(snapshot->states, digitalPinBytes);
+      break;
+    case EXIORDDC:
+      releaseAttention();
+      write(snapshot->changes, snapshot->changeBytes);
+      deltaSentSnapshot = frontSnapshot;
+      deltaSent = true;
+      break;
+    // EXIORDY alone if unchanged, or EXIORDG, the generation LSB first and the inputs
+    case EXIORDG: {
+      uint8_t inputBytes = digitalPinBytes + snapshot->inputBytes[1];
+      bool changed = ((snapshot->generation[1] << 8) + snapshot->generation[0]) != lastSeenGeneration;
+      if (!changed) {
+        generationStatus = EXIORDY;
+      } else if (3 + inputBytes <= MAX_RESPONSE_BYTES) {
+        generationStatus = EXIORDG;
+      } else {
+        generationStatus = EXIOERR;   // Too big for the transport, use EXIORDD and EXIORDAN
+      }
+      write(&generationStatus, 1);
+      if (generationStatus == EXIORDG) {
+        write(snapshot->generation, 2);
+        write(snapshot->states, inputBytes);
+      }
+      if (generationStatus != EXIOERR) {
+        releaseAttention();    // CommandStation has the current inputs
+      }
+      break;
+    }
+    // Byte counts then the inputs, or EXIOERR if they don't fit in one response
+    case EXIORDALL:
+      if (2 + digitalPinBytes + snapshot->inputBytes[1] > MAX_RESPONSE_BYTES) {
+        write(errorResponse, 1);
+        break;
+      }
+      releaseAttention();
+      write(snapshot->inputBytes, 2);
+      write(snapshot->states, digitalPinBytes + snapshot->inputBytes[1]);
+      break;
+    default:
+      write(stagedResponse, stagedResponseBytes);
+      break;
+  }
+}
+
+/*
+* Function to stage REGISTER_READ_BYTES registers starting at the register pointer, inputs
+* come from the front snapshot
+*/
+void stageRegisters(uint8_t registerPointer) {
+  InputSnapshot* snapshot = &inputSnapshots[frontSnapshot];
+  uint8_t address = registerPointer;
+  for (uint8_t registerByte = 0; registerByte < REGISTER_READ_BYTES; registerByte++) {
+    registerBuffer[registerByte] = readRegister(address++, snapshot);
+  }
+  if (registerPointer <= REG_DIGITAL + digitalPinBytes && address > REG_DIGITAL) {
+    releaseAttention();    // Digital inputs have been staged for reading
+  }
+  stagedResponse = registerBuffer;
+  stagedResponseBytes = REGISTER_READ_BYTES;
+}
+
+/*
+* Function to return the value of a single register, inputs come from the given snapshot
+*/
+uint8_t readRegister(uint8_t address, InputSnapshot* snapshot) {
+  if (address >= REG_PIN_CONFIG) {
+    uint8_t pin = address - REG_PIN_CONFIG;
+    if (pin >= numPins) return 0;
+    return (exioPins.mode[pin] & 0x07) | (pinBitRead(exioPins.direction, pin) << 4) |
+      (pinBitRead(exioPins.pullup, pin) << 5) | (pinBitRead(exioPins.enable, pin) << 7);
+  } else if (address >= REG_ANALOGUE_MAP) {
+    uint8_t channel = address - REG_ANALOGUE_MAP;
+    return channel < numAnaloguePins ? analoguePinMap[channel] : 0;
+  } else if (address >= REG_ANALOGUE) {
+    uint8_t aPinByte = address - REG_ANALOGUE;
+    return aPinByte < snapshot->inputBytes[1] ? snapshot->states[digitalPinBytes + aPinByte] : 0;
+  } else if (address >= REG_DIGITAL) {
+    uint8_t dPinByte = address - REG_DIGITAL;
+    return dPinByte < digitalPinBytes ? snapshot->states[dPinByte] : 0;
+  }
+  switch(address) {
+    case REG_VERSION:
+    case REG_VERSION + 1:
+    case REG_VERSION + 2:
+      return versionBuffer[address - REG_VERSION];
+    case REG_NUM_PINS:
+      return numPins;
+    case REG_NUM_DIGITAL:
+      return numDigitalPins;
+    case REG_NUM_ANALOGUE:
+      return numAnaloguePins;
+    case REG_DIGITAL_BYTES:
+      return digitalPinBytes;
+    case REG_ANALOGUE_BYTES:
+      return snapshot->inputBytes[1];
+    case REG_ANALOGUE_ENC:
+      return snapshot->analogueEncoding;
+    case REG_GENERATION:
+      return snapshot->generation[0];
+    case REG_GENERATION_MSB:
+      return snapshot->generation[1];
+    case REG_STATUS:
+      return (setupComplete << STATUS_SETUP_COMPLETE) | (attentionActive << STATUS_ATTENTION) |
+        ((inputEventsDropped != inputEventsDroppedAcked) << STATUS_EVENT_OVERFLOW);
+    case REG_EVENTS:
+      return (inputEventHead - inputEventTail) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    default:
+      return 0;
+  }
+}
+
+/*
+* Function to stage up to maxEntries log entries not yet read by the CommandStation
+* The first byte is the number of entries with bit 7 set if any were lost since the last read,
+* followed by 4 bytes per entry: code, pin, then arg LSB first
+*/
+void stageLogEntries(uint8_t maxEntries) {
+  if (maxEntries > MAX_LOG_PER_READ) maxEntries = MAX_LOG_PER_READ;
+  uint8_t head = logHead;
+  uint8_t tail = logReadTail;
+  bool lost = false;
+  if ((uint8_t)(head - tail) > LOG_QUEUE_SIZE - 1) {
+    tail = head - (LOG_QUEUE_SIZE - 1);   // Skip overwritten entries and the one being written
+    lost = true;
+  }
+  uint8_t numEntries = 0;
+  uint8_t entryBytes = 1;
+  while (numEntries < maxEntries && tail != head) {
+    LogEntry* entry = &logEntries[tail & (LOG_QUEUE_SIZE - 1)];
+    logBuffer[entryBytes++] = entry->code;
+    logBuffer[entryBytes++] = entry->pin;
+    logBuffer[entryBytes++] = entry->arg & 0xFF;
+    logBuffer[entryBytes++] = entry->arg >> 8;
+    tail++;
+    numEntries++;
+  }
+  logReadTail = tail;
+  logBuffer[0] = numEntries | (lost << 7);
+  stagedResponse = logBuffer;
+  stagedResponseBytes = entryBytes;
+}
+
+/*
+* Function to build the capability descriptor, called once pin details and version are set
+*/
+void setupCapabilities() {
+  uint16_t features = bit(FEATURE_DELTA_READ) | bit(FEATURE_GENERATION_READ) | bit(FEATURE_READ_ALL) |
+    bit(FEATURE_BULK_WRITE) | bit(FEATURE_BATCH) | bit(FEATURE_CONFIGURE) | bit(FEATURE_ANALOGUE_ENC) |
+    bit(FEATURE_ANALOGUE_MASK) | bit(FEATURE_INPUT_EVENTS) | bit(FEATURE_REGISTER_MAP) |
+    bit(FEATURE_OUTPUT_LATCH) | bit(FEATURE_LOG);
+#if defined(SPI_TRANSPORT)
+  features |= bit(FEATURE_SPI);
+#elif defined(UART_TRANSPORT)
+  features |= bit(FEATURE_UART);
+#endif
+#if defined(I2C_GENERAL_CALL)
+  features |= bit(FEATURE_GENERAL_CALL);
+#endif
+#if defined(ATTENTION_PIN)
+  features |= bit(FEATURE_ATTENTION);
+#endif
+  capabilityBuffer[0] = CAPS_BYTES;
+  capabilityBuffer[1] = CAPS_FORMAT;
+  capabilityBuffer[2] = versionBuffer[0];
+  capabilityBuffer[3] = versionBuffer[1];
+  capabilityBuffer[4] = versionBuffer[2];
+  capabilityBuffer[5] = numPins;
+  capabilityBuffer[6] = numDigitalPins;
+  capabilityBuffer[7] = numAnaloguePins;
+  capabilityBuffer[8] = numPWMPins;
+#if defined(HAS_SERVO_LIB)
+  capabilityBuffer[9] = MAX_SERVOS;
+#endif
+  capabilityBuffer[10] = MAX_SUPERPINS;
+  capabilityBuffer[11] = features & 0xFF;
+  capabilityBuffer[12] = features >> 8;
+  capabilityBuffer[13] = COMMAND_QUEUE_SIZE;
+  capabilityBuffer[14] = MAX_BATCH_COMMANDS;
+  capabilityBuffer[15] = INPUT_EVENT_QUEUE_SIZE;
+  capabilityBuffer[16] = MAX_EVENTS_PER_READ;
+  capabilityBuffer[17] = STAGED_OUTPUT_SIZE;
+  capabilityBuffer[18] = REGISTER_READ_BYTES;
+  for (uint8_t pin = 0; pin < numPins; pin++) {
+    capabilityBuffer[CAPS_HEADER_BYTES + pin / 2] |= (pinMap[pin].capability & 0x0F) << ((pin % 2) * 4);
+  }
+}
+
+/*
+* Function to stage the response for the next writeResponse() based on outboundFlag
+*/
+void stageResponse() {
+  switch(outboundFlag) {
+    case EXIOINIT:
+      if (setupComplete) {
+        commandBuffer[0] = EXIOPINS;
+        commandBuffer[1] = numDigitalPins;
+        commandBuffer[2] = numAnaloguePins;
+      } else {
+        commandBuffer[0] = 0;
+        commandBuffer[1] = 0;
+        commandBuffer[2] = 0;
+      }
+      stagedResponse = commandBuffer;
+      stagedResponseBytes = 3;
+      break;
+    case EXIOINITA:
+      stagedResponse = analoguePinMap;
+      stagedResponseBytes = numAnaloguePins;
+      break;
+    case EXIOVER:
+      stagedResponse = versionBuffer;
+      stagedResponseBytes = 3;
+      break;
+    case EXIOCAPS:
+      // Longer descriptors are read in parts using the offset, from the length in byte 0
+      stagedResponse = capabilityBuffer + capabilityOffset;
+      stagedResponseBytes = CAPS_BYTES - capabilityOffset;
+      if (stagedResponseBytes > MAX_RESPONSE_BYTES) {
+        stagedResponseBytes = MAX_RESPONSE_BYTES;
+      }
+      break;
+    case EXIODPUP:
+    case EXIOENAN:
+    case EXIOWRAN:
+    case EXIOWRD:
+    case EXIOWRDM:
+    case EXIOCFG:
+    case EXIOANENC:
+    case EXIOLATCH:
+    case EXIOCOMMIT:
+      stagedResponse = responseBuffer;
+      stagedResponseBytes = 1;
+      break;
+    case EXIOBATCH:
+      stagedResponse = batchResponseBuffer;
+      stagedResponseBytes = batchResponseBytes;
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+* Function to stage the selected analogue channels from the front snapshot in their current
+* encoding, channels are sent in channel order and packed 10 bit is repacked in groups of 4,
+* with the last group padded to 5 bytes as for EXIORDAN
+*/
+void stageSelectedAnalogue(byte* mask, uint8_t maskBytes) {
+  InputSnapshot* snapshot = &inputSnapshots[frontSnapshot];
+  byte* states = snapshot->states + digitalPinBytes;
+  uint8_t encoding = snapshot->analogueEncoding;
+  uint8_t selected = 0;
+  if (encoding == ANALOGUE_PACKED10) {
+    for (uint8_t aPinByte = 0; aPinByte < ANALOGUE_PIN_BYTES; aPinByte++) {
+      analogueSelectBuffer[aPinByte] = 0;   // Padding in the last group is sent as 0
+    }
+  }
+  for (uint8_t channel = 0; channel < numAnaloguePins && channel / 8 < maskBytes; channel++) {
+    if (!bitRead(mask[channel / 8], channel % 8)) continue;
+    encodeAnalogue(analogueSelectBuffer, encoding, selected, decodeAnalogue(states, encoding, channel));
+    selected++;
+  }
+  stagedResponse = analogueSelectBuffer;
+  stagedResponseBytes = analogueEncodedBytes(encoding, selected);
+}
+
+/*
+* Function to remove the events sent by the last EXIORDEV response from the queue, once the
+* CommandStation confirms it received them by echoing the response's first byte. Anything else
+* leaves them queued, so the events from a failed read are sent again.
+*/
+void acknowledgeInputEvents(uint8_t received) {
+  if (received == eventBuffer[0]) {
+    inputEventTail = (inputEventTail + stagedEventCount) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    inputEventsDroppedAcked = stagedEventsDropped;
+  }
+  stagedEventCount = 0;
+  stagedEventsDropped = inputEventsDroppedAcked;
+}
+
+/*
+* Function to stage up to maxEvents input change events, they stay queued until acknowledged
+* The first byte is the number of events with bit 7 set if any were dropped since the last
+* acknowledged read, followed by 5 bytes per event: pin number with the new state in bit 7,
+* then micros() LSB first
+*/
+void stageInputEvents(uint8_t maxEvents) {
+  if (maxEvents > MAX_EVENTS_PER_READ) maxEvents = MAX_EVENTS_PER_READ;
+  uint8_t tail = inputEventTail;
+  uint8_t numEvents = 0;
+  uint8_t eventBytes = 1;
+  while (numEvents < maxEvents && tail != inputEventHead) {
+    eventBuffer[eventBytes++] = inputEvents[tail].pinState;
+    uint32_t timestamp = inputEvents[tail].timestamp;
+    for (uint8_t timeByte = 0; timeByte < 4; timeByte++) {
+      eventBuffer[eventBytes++] = timestamp >> (timeByte * 8);
+    }
+    tail = (tail + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    numEvents++;
+  }
+  stagedEventCount = numEvents;
+  stagedEventsDropped = inputEventsDropped;
+  eventBuffer[0] = numEvents | ((stagedEventsDropped != inputEventsDroppedAcked) << 7);
+  stagedResponse = eventBuffer;
+  stagedResponseBytes = eventBytes;
+}
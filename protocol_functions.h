@@ -0,0 +1,42 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROTOCOL_FUNCTIONS_H
+#define PROTOCOL_FUNCTIONS_H
+
+#include <Arduino.h>
+#include "globals.h"
+
+// Function a transport provides to writeResponse() to send each part of a response
+typedef void (*ResponseWriter)(const byte* data, uint8_t bytes);
+
+extern uint8_t numReceivedPins;
+
+void processFrame(byte* buffer, uint8_t numBytes);
+void writeResponse(ResponseWriter write);
+void stageResponse();
+void setupCapabilities();
+void stageRegisters(uint8_t registerPointer);
+uint8_t readRegister(uint8_t address, InputSnapshot* snapshot);
+void stageSelectedAnalogue(byte* mask, uint8_t maskBytes);
+void acknowledgeInputEvents(uint8_t received);
+void stageInputEvents(uint8_t maxEvents);
+void stageLogEntries(uint8_t maxEntries);
+
+#endif
@@ -31,38 +31,43 @@ const uint8_t superPinMax = 255;
 
 const unsigned int refreshInterval = 50;
 unsigned long lastRefresh = 0;
-ServoData** servoDataArray;
+ServoData* servoDataArray[TOTAL_PINS];
+uint8_t animatingServos[TOTAL_PINS];   // Pins with a servo or SuperPin animation in progress
+uint8_t numAnimatingServos = 0;
 
 void processServos() {
   if (millis() - lastRefresh > refreshInterval) {
     lastRefresh = millis();
-    for (uint8_t pin = 0; pin < numPins; pin++) {
-      if (servoDataArray[pin] != NULL) {
-        updatePosition(pin);
+    for (uint8_t active = 0; active < numAnimatingServos;) {
+      if (updatePosition(animatingServos[active])) {
+        active++;
+      } else {
+        animatingServos[active] = animatingServos[--numAnimatingServos];  // Finished, swap the last one in
       }
     }
   }
 }
 
-void updatePosition(uint8_t pin) {
+/*
+* Function to move a servo or SuperPin one step, returns false once there's nothing left to do
+*/
+bool updatePosition(uint8_t pin) {
   struct ServoData *s = servoDataArray[pin];
-  if (s == NULL) return; // No pin configuration/state data
-  
-  uint8_t pinByte = pin / 8;
-  uint8_t pinBit = pin - pinByte * 8;
+  if (s == NULL) return false; // No pin configuration/state data
+
   if (s->numSteps == 0) {
-    bitClear(digitalPinStates[pinByte], pinBit);
-    return; // No animation in progress
+    setDigitalPinState(pin, false);
+    return false; // No animation in progress
   }
 
   if (s->stepNumber == 0 && s->fromPosition == s->toPosition) {
     // Go straight to end of sequence, output final position.
-    bitSet(digitalPinStates[pinByte], pinBit);
+    setDigitalPinState(pin, true);
     s->stepNumber = s->numSteps-1;
   }
 
   if (s->stepNumber < s->numSteps) {
-    bitSet(digitalPinStates[pinByte], pinBit);
+    setDigitalPinState(pin, true);
     // Animation in progress, reposition servo
     s->stepNumber++;
     bool useSuperPin = s->currentProfile & USE_SUPERPIN;
@@ -75,27 +80,41 @@ void updatePosition(uint8_t pin) {
       s->currentPosition = map(s->stepNumber, 0, s->numSteps, s->fromPosition, s->toPosition);
     }
     // Send servo command
-    bitSet(digitalPinStates[pinByte], pinBit);
+    setDigitalPinState(pin, true);
     writeServo(pin, s->currentPosition, useSuperPin);
   } else if (s->stepNumber < s->numSteps + _catchupSteps) {
-    bitSet(digitalPinStates[pinByte], pinBit);
+    setDigitalPinState(pin, true);
     // We've finished animation, wait a little to allow servo to catch up
     s->stepNumber++;
   } else if (s->stepNumber == s->numSteps + _catchupSteps 
             && s->currentPosition != 0) {
-    bitClear(digitalPinStates[pinByte], pinBit);
+    setDigitalPinState(pin, false);
     s->numSteps = 0;  // Done now.
+    return false;
+  } else {
+    return false;   // Finished at position 0, nothing changes from here
+  }
+  return true;
+}
+
+/*
+* Function to add a pin to the animating list for processServos(), if it isn't already there
+*/
+void startServoAnimation(uint8_t pin) {
+  for (uint8_t active = 0; active < numAnimatingServos; active++) {
+    if (animatingServos[active] == pin) return;
   }
+  animatingServos[numAnimatingServos++] = pin;
 }
 
 bool configureServo(uint8_t pin, bool useSuperPin) {
-  if (exioPins[pin].servoIndex == 255) {
+  if (exioPins.servoIndex[pin] == 255) {
     if (useSuperPin && nextSuperPinObject < MAX_SUPERPINS && bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
-      exioPins[pin].servoIndex = nextSuperPinObject;
+      exioPins.servoIndex[pin] = nextSuperPinObject;
       nextSuperPinObject++;
 #if defined(HAS_SERVO_LIB)
     } else if (nextServoObject < MAX_SERVOS && bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
-      exioPins[pin].servoIndex = nextServoObject;
+      exioPins.servoIndex[pin] = nextServoObject;
       nextServoObject++;
 #endif
     } else {
@@ -103,8 +122,8 @@ bool configureServo(uint8_t pin, bool useSuperPin) {
     }
   }
 #if defined(HAS_SERVO_LIB)
-  if (!useSuperPin && !servoMap[exioPins[pin].servoIndex].attached()) {
-    servoMap[exioPins[pin].servoIndex].attach(pinMap[pin].physicalPin);
+  if (!useSuperPin && !servoMap[exioPins.servoIndex[pin]].attached()) {
+    servoMap[exioPins.servoIndex[pin]].attach(pinMap[pin].physicalPin);
   }
 #endif
   return true;
@@ -115,11 +134,11 @@ void writeServo(uint8_t pin, uint16_t value, bool useSuperPin) {
 #if defined(HAS_SERVO_LIB)
   useServoLib = true;
 #endif
-  if (useServoLib && exioPins[pin].mode == MODE_PWM) {
+  if (useServoLib && exioPins.mode[pin] == MODE_PWM) {
 #if defined(HAS_SERVO_LIB)
-    servoMap[exioPins[pin].servoIndex].writeMicroseconds(value);
+    servoMap[exioPins.servoIndex[pin]].writeMicroseconds(value);
 #endif
-  } else if (useSuperPin && exioPins[pin].mode == MODE_PWM_LED) {
+  } else if (useSuperPin && exioPins.mode[pin] == MODE_PWM_LED) {
     setSuperPin(pin, value);
   } else {
     if (value >= 0 && value <= 255) {
@@ -33,8 +33,12 @@ extern uint8_t nextServoObject;
 #endif
 extern uint8_t nextSuperPinObject;
 
+extern uint8_t animatingServos[TOTAL_PINS];
+extern uint8_t numAnimatingServos;
+
 void processServos();
-void updatePosition(uint8_t pin);
+bool updatePosition(uint8_t pin);
+void startServoAnimation(uint8_t pin);
 bool configureServo(uint8_t pin, bool useSuperPin);
 void writeServo(uint8_t pin, uint16_t value, bool useSuperPin);
 void setSuperPin(uint8_t pin, uint16_t value);
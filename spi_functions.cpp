@@ -0,0 +1,166 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+* Optional SPI slave transport, enabled with SPI_TRANSPORT in myConfig.h, carrying the same
+* frames as I2C. Each transaction, from chip select low to high, carries one frame from the
+* CommandStation, and the bytes clocked back during it are the response to the previous frame.
+* A read is therefore sent, then collected by the next transaction, which can carry the next
+* read so polling needs one transaction per read. A frame starting with 0 changes nothing and
+* collects the response again.
+* On AVR each byte is handled by the SPI interrupt, so keep the SPI clock at 1MHz or less. On
+* the STM32F4 Nucleos the frame is moved by DMA and only chip select going high interrupts.
+*/
+
+#include <Arduino.h>
+#include "globals.h"
+#include "spi_functions.h"
+#include "protocol_functions.h"
+
+#if defined(SPI_TRANSPORT)
+
+byte spiRxBuffer[SPI_BUFFER_SIZE];  // Frame being received from the CommandStation
+byte spiTxBuffer[SPI_BUFFER_SIZE];  // Response to the previous frame being sent
+uint16_t spiRxBytes = 0;
+uint16_t spiTxBytes = 0;
+uint16_t spiTxIndex = 0;
+
+/*
+* Function to add part of the response to the SPI transmit buffer, anything over
+* SPI_BUFFER_SIZE is dropped
+*/
+void spiWrite(const byte* data, uint8_t bytes) {
+  for (uint8_t dataByte = 0; dataByte < bytes && spiTxBytes < SPI_BUFFER_SIZE; dataByte++) {
+    spiTxBuffer[spiTxBytes++] = data[dataByte];
+  }
+}
+
+/*
+* Function called when chip select goes high, acts on the received frame and prepares the
+* response for the next transaction
+*/
+void endSPIFrame(uint16_t receivedBytes) {
+  if (receivedBytes > 0 && spiRxBuffer[0] != 0) {
+    processFrame(spiRxBuffer, receivedBytes > 255 ? 255 : receivedBytes);
+  }
+  spiTxBytes = 0;
+  writeResponse(spiWrite);
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+/*
+* Function to start the hardware SPI in slave mode, chip select is watched by the pin change
+* interrupt on port B, which SS is on for all supported AVR boards
+*/
+void setupSPI() {
+  pinMode(SS, INPUT);
+  pinMode(SCK, INPUT);
+  pinMode(MOSI, INPUT);
+  pinMode(MISO, INPUT);   // Only driven while selected so other devices can share the bus
+  endSPIFrame(0);
+  SPDR = spiTxBuffer[0];
+  SPCR = _BV(SPE) | _BV(SPIE);
+  *digitalPinToPCMSK(SS) |= _BV(digitalPinToPCMSKbit(SS));
+  *digitalPinToPCICR(SS) |= _BV(digitalPinToPCICRbit(SS));
+}
+
+ISR(SPI_STC_vect) {
+  byte received = SPDR;
+  spiTxIndex++;
+  SPDR = spiTxIndex < spiTxBytes ? spiTxBuffer[spiTxIndex] : 0;
+  if (spiRxBytes < SPI_BUFFER_SIZE) {
+    spiRxBuffer[spiRxBytes++] = received;
+  }
+}
+
+ISR(PCINT0_vect) {
+  if (digitalRead(SS) == LOW) {
+    pinMode(MISO, OUTPUT);
+    return;
+  }
+  pinMode(MISO, INPUT);
+  endSPIFrame(spiRxBytes);
+  spiRxBytes = 0;
+  spiTxIndex = 0;
+  SPDR = spiTxBuffer[0];
+}
+
+#elif defined(ARDUINO_NUCLEO_F411RE) || defined(ARDUINO_NUCLEO_F412ZG)
+#define SPI_RX_STREAM DMA2_Stream0  // SPI1_RX is DMA2 stream 0 channel 3
+#define SPI_TX_STREAM DMA2_Stream3  // SPI1_TX is DMA2 stream 3 channel 3
+#define SPI_DMA_CHANNEL (3 << DMA_SxCR_CHSEL_Pos)
+
+/*
+* Function to set up SPI1 on PA4-PA7 with its hardware chip select, the end of each
+* transaction is seen by an interrupt on PA4 going high
+*/
+void setupSPI() {
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  attachInterrupt(digitalPinToInterrupt(SPI_NSS_PIN), spiDeselected, RISING);
+  GPIO_InitTypeDef gpio = {};
+  gpio.Pin = GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7;
+  gpio.Mode = GPIO_MODE_AF_PP;
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+  gpio.Alternate = GPIO_AF5_SPI1;
+  HAL_GPIO_Init(GPIOA, &gpio);  // Leaves the PA4 rising edge interrupt configured
+  endSPIFrame(0);
+  startSPIDMA();
+}
+
+/*
+* Function to reset SPI1 and both DMA streams, then arm them for the next transaction
+* Resetting SPI1 discards the byte already loaded for a transaction that ended early
+*/
+void startSPIDMA() {
+  SPI_RX_STREAM->CR &= ~DMA_SxCR_EN;
+  SPI_TX_STREAM->CR &= ~DMA_SxCR_EN;
+  while ((SPI_RX_STREAM->CR & DMA_SxCR_EN) || (SPI_TX_STREAM->CR & DMA_SxCR_EN)) {}
+  __HAL_RCC_SPI1_FORCE_RESET();
+  __HAL_RCC_SPI1_RELEASE_RESET();
+  __HAL_RCC_SPI1_CLK_ENABLE();
+  DMA2->LIFCR = 0x0000003D | 0x0F400000;  // Clear all stream 0 and stream 3 flags
+  SPI_RX_STREAM->PAR = (uint32_t)&SPI1->DR;
+  SPI_RX_STREAM->M0AR = (uint32_t)spiRxBuffer;
+  SPI_RX_STREAM->NDTR = SPI_BUFFER_SIZE;
+  SPI_RX_STREAM->CR = SPI_DMA_CHANNEL | DMA_SxCR_MINC;
+  SPI_TX_STREAM->PAR = (uint32_t)&SPI1->DR;
+  SPI_TX_STREAM->M0AR = (uint32_t)spiTxBuffer;
+  SPI_TX_STREAM->NDTR = spiTxBytes > 0 ? spiTxBytes : 1;
+  SPI_TX_STREAM->CR = SPI_DMA_CHANNEL | DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+  SPI_RX_STREAM->CR |= DMA_SxCR_EN;
+  SPI_TX_STREAM->CR |= DMA_SxCR_EN;
+  SPI1->CR2 = SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+  SPI1->CR1 = SPI_CR1_SPE;  // Slave, mode 0, 8 bit, MSB first, hardware chip select
+}
+
+/*
+* Function called by the PA4 interrupt at the end of each transaction
+*/
+void spiDeselected() {
+  endSPIFrame(SPI_BUFFER_SIZE - SPI_RX_STREAM->NDTR);
+  startSPIDMA();
+}
+
+#else
+#error SPI_TRANSPORT is only supported on the Nano, Uno, Pro Mini, Mega and STM32F4 Nucleo boards
+#endif
+
+#endif
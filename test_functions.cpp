@@ -45,9 +45,7 @@ void testAnalogue(bool enable) {
     analogueTesting = true;
     for (uint8_t pin = 0; pin < numPins; pin++) {
       if (bitRead(pinMap[pin].capability, ANALOGUE_INPUT)) {
-        exioPins[pin].enable = 1;
-        exioPins[pin].mode = MODE_ANALOGUE;
-        exioPins[pin].direction = 1;
+        enableAnalogue(pin);
       }
     }
   } else {
@@ -69,12 +67,13 @@ void testInput(bool enable) {
     inputTesting = true;
     for (uint8_t pin = 0; pin < numPins; pin++) {
       if (bitRead(pinMap[pin].capability, DIGITAL_INPUT)) {
-        exioPins[pin].enable = 1;
-        exioPins[pin].mode = MODE_DIGITAL;
-        exioPins[pin].pullup = 0;
-        exioPins[pin].direction = 1;
+        pinBitWrite(exioPins.enable, pin, 1);
+        exioPins.mode[pin] = MODE_DIGITAL;
+        pinBitWrite(exioPins.pullup, pin, 0);
+        pinBitWrite(exioPins.direction, pin, 1);
       }
     }
+    pinConfigChanged();
   } else {
     inputTesting = false;
     diag = false;
@@ -94,11 +93,12 @@ void testOutput(bool enable) {
     outputTesting = true;
     for (uint8_t pin = 0; pin < numPins; pin++) {
       if (bitRead(pinMap[pin].capability, DIGITAL_OUTPUT)) {
-        exioPins[pin].enable = 1;
-        exioPins[pin].mode = DIGITAL_OUTPUT;
-        exioPins[pin].direction = 0;
+        pinBitWrite(exioPins.enable, pin, 1);
+        exioPins.mode[pin] = DIGITAL_OUTPUT;
+        pinBitWrite(exioPins.direction, pin, 0);
       }
     }
+    pinConfigChanged();
   } else {
     outputTesting = false;
     diag = false;
@@ -118,12 +118,13 @@ void testPullup(bool enable) {
     pullupTesting = true;
     for (uint8_t pin = 0; pin < numPins; pin++) {
       if (bitRead(pinMap[pin].capability, DIGITAL_INPUT)) {
-        exioPins[pin].enable = 1;
-        exioPins[pin].mode = MODE_DIGITAL;
-        exioPins[pin].pullup = 1;
-        exioPins[pin].direction = 1;
+        pinBitWrite(exioPins.enable, pin, 1);
+        exioPins.mode[pin] = MODE_DIGITAL;
+        pinBitWrite(exioPins.pullup, pin, 1);
+        pinBitWrite(exioPins.direction, pin, 1);
       }
     }
+    pinConfigChanged();
   } else {
     pullupTesting = false;
     diag = false;
@@ -137,7 +138,8 @@ void testServo(uint8_t vpin, uint16_t value, uint8_t profile) {
   } else if (analogueTesting || inputTesting || outputTesting || pullupTesting) {
     USB_SERIAL.println(F("Please disable all other testing first"));
   } else {
-    String pinLabel = pinNameMap[vpin].pinLabel;
+    char pinLabel[PIN_LABEL_SIZE];
+    getPinLabel(vpin, pinLabel);
     USB_SERIAL.print(F("Test move servo or dim LED - vpin|physicalPin|value|profile:"));
     USB_SERIAL.print(vpin);
     USB_SERIAL.print(F("|"));
@@ -0,0 +1,158 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+* Optional UART transport for RS-485 multidrop, enabled with UART_TRANSPORT in myConfig.h,
+* carrying the same frames as I2C. Every packet is:
+*   UART_START, device address, frame length, frame bytes, CRC-8 of address, length and frame
+* The addressed device replies straight away with a packet in the same format, with bit 7 of
+* the address set and the response as the frame. Packets to address 0 are acted on by every
+* device and not replied to, as for the I2C general call.
+* Packets are read from loop(), so unlike I2C and SPI nothing here runs in an interrupt.
+*/
+
+#include <Arduino.h>
+#include "globals.h"
+#include "uart_functions.h"
+#include "protocol_functions.h"
+
+#if defined(UART_TRANSPORT)
+
+byte uartBuffer[UART_BUFFER_SIZE];  // Frame being received, then the response being sent
+uint8_t uartState = UART_WAIT_START;
+uint8_t uartAddress = 0;
+uint8_t uartFrameBytes = 0;
+uint8_t uartReceivedBytes = 0;
+uint8_t uartResponseBytes = 0;
+unsigned long lastUARTByte = 0;   // millis() of the last byte received, used to drop partial packets
+
+/*
+* Function to start the UART, and the RS-485 driver enable pin if defined
+*/
+void setupUART() {
+#if defined(RS485_DE_PIN)
+  pinMode(RS485_DE_PIN, OUTPUT);
+  digitalWrite(RS485_DE_PIN, LOW);
+#endif
+  UART_SERIAL.begin(UART_BAUD);
+}
+
+/*
+* Function to read any received bytes and act on each complete packet, called from loop()
+*/
+void processUART() {
+  while (UART_SERIAL.available()) {
+    byte received = UART_SERIAL.read();
+    if (uartState != UART_WAIT_START && millis() - lastUARTByte > UART_PACKET_TIMEOUT) {
+      uartState = UART_WAIT_START;
+    }
+    lastUARTByte = millis();
+    switch(uartState) {
+      case UART_WAIT_START:
+        if (received == UART_START) {
+          uartState = UART_ADDRESS;
+        }
+        break;
+      case UART_ADDRESS:
+        uartAddress = received;
+        uartState = UART_LENGTH;
+        break;
+      case UART_LENGTH:
+        uartFrameBytes = received;
+        uartReceivedBytes = 0;
+        if (uartFrameBytes == 0 || uartFrameBytes > UART_BUFFER_SIZE) {
+          uartState = UART_WAIT_START;
+        } else {
+          uartState = UART_FRAME;
+        }
+        break;
+      case UART_FRAME:
+        uartBuffer[uartReceivedBytes++] = received;
+        if (uartReceivedBytes == uartFrameBytes) {
+          uartState = UART_CRC;
+        }
+        break;
+      case UART_CRC:
+        uartState = UART_WAIT_START;
+        if (received != uartCRC(uartAddress, uartBuffer, uartFrameBytes)) break;
+        if (uartAddress == i2cAddress) {
+          processFrame(uartBuffer, uartFrameBytes);
+          uartResponseBytes = 0;
+          writeResponse(uartWrite);
+          sendUARTResponse();
+        } else if (uartAddress == 0) {
+          processFrame(uartBuffer, uartFrameBytes);
+        }
+        break;
+      default:
+        uartState = UART_WAIT_START;
+        break;
+    }
+  }
+}
+
+/*
+* Function to add part of the response to the UART buffer, anything over UART_BUFFER_SIZE is dropped
+*/
+void uartWrite(const byte* data, uint8_t bytes) {
+  for (uint8_t dataByte = 0; dataByte < bytes && uartResponseBytes < UART_BUFFER_SIZE; dataByte++) {
+    uartBuffer[uartResponseBytes++] = data[dataByte];
+  }
+}
+
+/*
+* Function to send the response packet, enabling the RS-485 driver only while sending
+*/
+void sendUARTResponse() {
+  uint8_t address = i2cAddress | 0x80;
+#if defined(RS485_DE_PIN)
+  digitalWrite(RS485_DE_PIN, HIGH);
+#endif
+  UART_SERIAL.write(UART_START);
+  UART_SERIAL.write(address);
+  UART_SERIAL.write(uartResponseBytes);
+  UART_SERIAL.write(uartBuffer, uartResponseBytes);
+  UART_SERIAL.write(uartCRC(address, uartBuffer, uartResponseBytes));
+#if defined(RS485_DE_PIN)
+  UART_SERIAL.flush();    // Wait for the last byte to leave before releasing the bus
+  digitalWrite(RS485_DE_PIN, LOW);
+#endif
+}
+
+/*
+* Function to calculate the CRC-8 (polynomial 0x07) of the address, length and frame bytes
+*/
+uint8_t uartCRC(uint8_t address, const byte* frame, uint8_t frameBytes) {
+  uint8_t crc = uartCRCByte(0, address);
+  crc = uartCRCByte(crc, frameBytes);
+  for (uint8_t frameByte = 0; frameByte < frameBytes; frameByte++) {
+    crc = uartCRCByte(crc, frame[frameByte]);
+  }
+  return crc;
+}
+
+uint8_t uartCRCByte(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ *  © 2023, Peter Cole. All rights reserved.
+ *  
+ *  This file is part of EX-IOExpander.
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  It is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CommandStation.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UART_FUNCTIONS_H
+#define UART_FUNCTIONS_H
+
+#include <Arduino.h>
+#include "globals.h"
+
+#if defined(UART_TRANSPORT)
+void setupUART();
+void processUART();
+void uartWrite(const byte* data, uint8_t bytes);
+void sendUARTResponse();
+uint8_t uartCRC(uint8_t address, const byte* frame, uint8_t frameBytes);
+uint8_t uartCRCByte(uint8_t crc, uint8_t data);
+#endif
+
+#endif
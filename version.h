@@ -2,8 +2,36 @@
 #define VERSION_H
 
 // Version must only ever be numeric in order to be able to send it to the CommandStation
-#define VERSION "0.0.23"
+#define VERSION "0.0.24"
 
+// 0.0.24 includes:
+//  - Add EXIORDDC to read only the digital input bytes that have changed since the last read
+//  - Add EXIORDG to skip sending input states when nothing has changed since the last read
+//  - Add EXIORDALL to read digital and analogue inputs in a single transaction
+//  - Add EXIOWRDM to write multiple digital outputs in one frame using set/clear masks
+//  - Add EXIOBATCH to send multiple EXIOWRD/EXIOWRAN/EXIODPUP/EXIOENAN commands in one frame
+//  - Add EXIOCFG to configure digital/pullup/analogue inputs for a range of pins in one frame
+//  - Add optional open drain ATTENTION_PIN asserted when a digital input changes until inputs are read
+//  - Send inputs from double buffered snapshots so reads never mix old and new values
+//  - Queue received commands and execute them from loop() instead of the I2C interrupt
+//  - Only the last queued EXIOWRD/EXIOWRAN to the same pin is executed
+//  - Add EXIOANENC to select 16 bit, 8 bit or packed 10 bit analogue input encoding
+//  - Add EXIORDANM to read only the analogue channels selected by a bitmask
+//  - Only sample analogue inputs that have been enabled
+//  - Add EXIORDEV to read timestamped digital input change events
+//  - Add EXIOREG to read any slice of a fixed register map of config, inputs, version and status
+//  - Add EXIOLATCH to hold output writes until EXIOCOMMIT, which can be broadcast by general call
+//  - Commit held digital outputs with one register write per port on AVR and STM32
+//  - Split the protocol core from I2C and add an optional SPI slave transport
+//  - Add an optional UART transport with addressed, CRC checked packets for RS-485 multidrop
+//  - Add EXIOCAPS to read pin capabilities, limits, features and buffer sizes in one descriptor
+//  - Log pin errors to a binary ring rendered from loop() and readable with EXIORDLOG
+//  - Add an optional in-tree I2C slave driver for AVR and STM32 with no response copies
+//  - Read each input port register once per scan instead of digitalRead() per pin
+//  - Only apply input pin modes when the configuration changes, not on every scan
+//  - Walk only the pins in use, and only the servos still moving, in the main loop and pin display
+//  - Pack the pin enable, direction and pullup flags into bitsets and check them a word at a time
+//  - Keep pin labels in flash and fix the pin counts and buffer sizes at compile time, no heap allocation
 // 0.0.23 includes:
 //  - Add use of Servo library for controlling servos for supported platforms
 //  - Add SuperPin class for neat dimming of LEDs without needing hardware PWM pins